@@ -21,7 +21,11 @@ optimizations = {
      '-reassociate', '-loop-rotate', '-licm', '-loop-unswitch',
      '-instcombine', '-indvars', '-loop-deletion', '-loop-unroll',
      '-instcombine', '-memcpyopt', '-sccp', '-instcombine',
-     '-dse', '-adce', '-simplifycfg', '-strip-dead-prototypes',
+     '-dse', '-adce', '-simplifycfg',
+     # flatten branches that only compute values,
+     # so that KLEE does not fork on them
+     '-if-convert',
+     '-strip-dead-prototypes',
      '-constmerge', '-ipsccp', '-deadargelim', '-die',
      '-instcombine'],
 
@@ -81,6 +81,42 @@ class SymbioticOptions(object):
         self.instrumentation_files_path = None
         # instrument tracking the state of the program into the program itself
         self.full_instrumentation = False
+        # remove checks that the interval analysis proves safe
+        self.prune_checks = False
+        # make external globals non-deterministic on their first access
+        self.lazy_globals = False
+        # JSON file with summaries of side-effects of undefined functions
+        self.undefined_summaries = None
+        # remove the functions that cannot be called from main after linking
+        self.remove_unreachable_functions = False
+        # replace calls via pointers with guarded direct calls
+        self.devirtualize_calls = False
+        # replace pure counting loops with the closed form of their results
+        self.accelerate_loops = False
+        # generate nondet values that are immediately assumed in a range
+        # directly from the range
+        self.fuse_nondet_assume = False
+        # make structs and arrays of at most this many bytes
+        # symbolic field by field (0 = never)
+        self.split_nondet = 0
+        # compare the state of loops that use at least this many
+        # variables at once when checking termination (0 = never)
+        self.nontermination_snapshot = 0
+        # clone functions for the call sites with constant arguments
+        self.specialize_calls = False
+        # execute the deterministic prefix of main at compile time
+        self.evaluate_prefix = False
+        # move the checks with loop-invariant conditions out of loops
+        self.hoist_checks = False
+        # turn globals used only in a function that runs once into locals
+        self.globals_to_locals = False
+        # insert the coverage targets before generating tests,
+        # so that only the uncovered targets are tried separately
+        self.coverage_targets = True
+        # put the coverage targets also on the edges of branches
+        self.coverage_edge_targets = False
+        # define undefined functions returning values instead of mocking them
+        self.symbolic_undefined = False
         # generate SV-COMP witnesses
         self.nowitness = True
         self.executable_witness = False
@@ -245,7 +281,16 @@ def parse_command_line():
                                     'search-include-paths', 'replay-error', 'cc',
                                     'report=', 'no-replay-error',
                                     'unroll=', 'full-instrumentation', 'target-settings=',
-                                    'witness-check='])
+                                    'witness-check=', 'prune-checks', 'lazy-globals',
+                                    'undefined-summaries=', 'remove-unreachable-functions',
+                                    'devirtualize-calls',
+                                    'accelerate-loops', 'fuse-nondet-assume',
+                                    'split-nondet=', 'nontermination-snapshot=',
+                                    'specialize-calls',
+                                    'evaluate-prefix', 'hoist-checks',
+                                    'globals-to-locals',
+                                    'no-coverage-targets', 'coverage-edge-targets',
+                                    'symbolic-undefined'])
                                    # add klee-params
     except getopt.GetoptError as e:
         err('{0}'.format(str(e)))
@@ -436,6 +481,44 @@ def parse_command_line():
             options.unroll_count = int(arg)
         elif opt == '--full-instrumentation':
             options.full_instrumentation = True
+        elif opt == '--prune-checks':
+            options.prune_checks = True
+        elif opt == '--lazy-globals':
+            options.lazy_globals = True
+        elif opt == '--undefined-summaries':
+            options.undefined_summaries = abspath(arg)
+        elif opt == '--remove-unreachable-functions':
+            options.remove_unreachable_functions = True
+        elif opt == '--devirtualize-calls':
+            options.devirtualize_calls = True
+        elif opt == '--accelerate-loops':
+            options.accelerate_loops = True
+        elif opt == '--fuse-nondet-assume':
+            options.fuse_nondet_assume = True
+        elif opt == '--specialize-calls':
+            options.specialize_calls = True
+        elif opt == '--evaluate-prefix':
+            options.evaluate_prefix = True
+        elif opt == '--hoist-checks':
+            options.hoist_checks = True
+        elif opt == '--globals-to-locals':
+            options.globals_to_locals = True
+        elif opt == '--no-coverage-targets':
+            options.coverage_targets = False
+        elif opt == '--coverage-edge-targets':
+            options.coverage_edge_targets = True
+        elif opt == '--symbolic-undefined':
+            options.symbolic_undefined = True
+        elif opt == '--split-nondet':
+            try:
+                options.split_nondet = int(arg)
+            except ValueError:
+                err('Invalid numerical argument for --split-nondet: {0}'.format(arg))
+        elif opt == '--nontermination-snapshot':
+            try:
+                options.nontermination_snapshot = int(arg)
+            except ValueError:
+                err('Invalid numerical argument for --nontermination-snapshot: {0}'.format(arg))
         elif opt == '--test-suite':
             options.testsuite_output = abspath(arg)
 
@@ -472,6 +555,9 @@ where OPTS can be following:
                                  but replace it with 0.
     --malloc-never-fails         Suppose malloc and calloc never return NULL
     --undefined-are-pure         Suppose that undefined functions have no side-effects
+    --undefined-summaries=FILE   Define the undefined functions that are described in
+                                 the given JSON file according to their summaries
+                                 (see transforms/ModelUndefined.cpp for the format)
     --no-verification            Do not run verification phase (handy for debugging)
     --optimize=opt1,...          Run optimizations, every item in the optimizations list
                                  is a string of type when-level, where when is 'before'
@@ -549,6 +635,50 @@ where OPTS can be following:
     --full-instrumentation       Tranform checking errors to reachability problem, i.e.
                                  instrument tracking of the state of the program directly
                                  into the program.
+    --prune-checks               Remove checks and error paths that are proven safe
+                                 by a cheap interval analysis before slicing
+                                 and again before verification.
+    --lazy-globals               Make external globals non-deterministic at their first
+                                 access instead of at the beginning of main.
+    --remove-unreachable-functions
+                                 Remove the functions that cannot be called from main
+                                 after linking the libraries.
+    --devirtualize-calls         Replace calls via function pointers with comparisons
+                                 of the pointer and direct calls of the possible targets.
+    --accelerate-loops           Before slicing, replace the loops that only compute
+                                 values (or fill/copy memory) with the closed form
+                                 of their results. Not used for termination.
+    --fuse-nondet-assume         Replace a nondet call followed by an assumption
+                                 on its value with a nondet value from the assumed
+                                 range (the names of the symbolic objects change,
+                                 so do not use it when generating tests).
+    --split-nondet=N             Make uninitialized and external structs and arrays
+                                 of at most N bytes symbolic field by field, so that
+                                 every field is a separate (small) symbolic object.
+    --nontermination-snapshot=N  When checking termination, keep the state of loops
+                                 with at least N variables in one buffer that is
+                                 compared with its snapshot by a single check.
+    --specialize-calls           Before slicing, clone functions for the call sites
+                                 that pass constants to the parameters that
+                                 the functions branch on, and fold the constants.
+    --evaluate-prefix            Execute the deterministic code at the beginning
+                                 of main (up to the first nondet call) at compile
+                                 time and put its results into the initializers
+                                 of globals. Not used for memory safety.
+    --hoist-checks               After slicing, evaluate the assertions and assumptions
+                                 with loop-invariant conditions once before the loop
+                                 instead of in every iteration.
+    --globals-to-locals          After slicing, turn the globals that are used only
+                                 in a function that runs at most once (e.g., main)
+                                 into local variables of the function.
+    --no-coverage-targets        When generating tests for coverage, do not record
+                                 which test targets are covered by the main KLEE
+                                 and try all targets separately.
+    --coverage-edge-targets      Put the coverage targets also on the edges of branches
+                                 (a call on every edge), not only at the ends of paths.
+    --symbolic-undefined         Define the undefined functions that return a value
+                                 so that they return a symbolic value (only the bytes
+                                 that the program uses), instead of letting KLEE mock them.
     --require-slicer             Abort if slicing fails/timeouts
 
     The sources can be LLVM bitcode, C code, or both mixed together.
@@ -80,6 +80,18 @@ class KleeToolFullInstrumentation(KleeBase):
             ('ERESOLV', re.compile('.*ERROR:.*Could not resolve.*'))
         ]
 
+    def passes_before_instrumentation(self):
+        """
+        Allocations of constant size that are freed in the same function
+        and do not escape it can live on the stack. This must happen
+        before the instrumentation, its calls take the pointers, and
+        after -mem2reg, the pointers are in stack slots before it.
+        """
+        passes = ['-mem2reg', '-heap-to-stack']
+        if self._options.malloc_never_fails:
+            passes.append('-heap-to-stack-never-fails')
+        return passes
+
     def passes_after_slicing(self):
         """
         Prepare the bitcode for verification after slicing:
@@ -260,6 +272,12 @@ class SymbioticTool(KleeBase):
             cc.run()
             verifier.curfile = cc.curfile
         
+    def passes_before_instrumentation(self):
+        if self.FullInstr:
+            return self.FullInstr.passes_before_instrumentation()
+
+        return []
+
     def passes_after_slicing(self):
         passes = []
         
@@ -421,6 +421,20 @@ class SymbioticTool(BaseTool, SymbioticBaseTool):
         # make external globals non-deterministic
         if not self._options.sv_comp:
             passes.append('-internalize-globals')
+            if self._options.lazy_globals:
+                passes.append('-internalize-globals-lazy')
+
+        # define the undefined functions so that they return symbolic
+        # values (only the bytes that the callers use), instead of letting
+        # KLEE mock them
+        if self._options.symbolic_undefined:
+            if self._options.undef_retval_nosym:
+                passes.append('-delete-undefined-nosym')
+            else:
+                passes.append('-delete-undefined')
+
+        if self._options.split_nondet > 0:
+            passes.append('-split-nondet-max-size={0}'.format(self._options.split_nondet))
 
         # for the memsafety property, make functions behave like they have
         # side-effects, because LLVM optimizations could remove them otherwise,
@@ -430,6 +444,9 @@ class SymbioticTool(BaseTool, SymbioticBaseTool):
         elif self._options.property.termination():
             passes.append('-instrument-nontermination')
             passes.append('-instrument-nontermination-mark-header')
+            if self._options.nontermination_snapshot > 0:
+                # compare the state of loops with many variables at once
+                passes.append('-instrument-nontermination-snapshot={0}'.format(self._options.nontermination_snapshot))
 
         return super().passes_after_slicing() + passes
 
@@ -19,6 +19,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 """
 
+import os
+
 from symbiotic.utils.utils import process_grep
 from symbiotic.utils import dbg
 from symbiotic.exceptions import SymbioticException
@@ -51,6 +53,8 @@ class SymbioticTool(KleeTool):
 
     def __init__(self, opts):
         super().__init__(opts)
+        # the targets for test generation found by -get-test-targets
+        self._targets_file = None
 
     def name(self):
         return 'svcomp' # if renamed, adjust models in lib\ folder
@@ -66,6 +70,22 @@ class SymbioticTool(KleeTool):
                                     'scripts/kleetester.py')
 
 
+    def actions_before_verification(self, symbiotic):
+        # insert the targets for test generation in advance, so that the main
+        # KLEE run records which of them it covers and kleetester can start
+        # the jobs only for the targets that remain uncovered
+        if not self._options.property.coverage() or \
+           not self._options.coverage_targets:
+            return
+
+        self._targets_file = os.path.abspath('symbiotic-test-targets.txt')
+        passes = ['-get-test-targets', '-get-test-targets-bitmap',
+                  '-get-test-targets-output={0}'.format(self._targets_file)]
+        if self._options.coverage_edge_targets:
+            passes.append('-get-test-targets-edges')
+        symbiotic.run_opt(passes)
+        symbiotic.link_undefined(['__symbiotic_cov_hit'])
+
     def cmdline(self, executable, options, tasks, propertyfile=None, rlimits={}):
         assert len(tasks) == 1
         prp = 'coverage'
@@ -77,7 +97,10 @@ class SymbioticTool(KleeTool):
                 prp = calls[0]
  
 
-        return [executable, prp, self._options.testsuite_output] + tasks
+        cmd = [executable, prp, self._options.testsuite_output] + tasks
+        if self._targets_file:
+            cmd.append(self._targets_file)
+        return cmd
 
 
     def determine_result(self, returncode, returnsignal, output, isTimeout):
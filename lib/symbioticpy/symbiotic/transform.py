@@ -3,6 +3,7 @@
 import os
 import sys
 import re
+import json
 
 from . exceptions import SymbioticExceptionalResult
 from . options import SymbioticOptions
@@ -282,6 +283,32 @@ class SymbioticCC(object):
             # not fatal, continue working
             dbg('Failed getting statistics')
 
+    def program_features(self):
+        """
+        Get the features of the current bitcode (sizes, used memory
+        operations, kinds of loops, threads, ...) as a dictionary.
+        Return None if the features could not be computed.
+        """
+        output = '{0}-features.json'.format(self.curfile[:self.curfile.rfind('.')])
+        cmd = ['opt', '-load', 'LLVMsbt.so', '-program-features',
+               '-program-features-output={0}'.format(output),
+               '-o', '/dev/null', self.curfile]
+        self._disable_new_pm(cmd)
+
+        try:
+            runcmd(cmd, DbgWatch('all'), 'Failed running opt')
+            with open(output, 'r') as f:
+                features = json.load(f)
+        except (SymbioticException, IOError, ValueError):
+            dbg('Failed getting the features of the program')
+            return None
+
+        if features.get('version') != 1:
+            dbg('Unsupported version of the program features')
+            return None
+
+        return features
+
     def _instrument(self):
         if not hasattr(self._tool, 'instrumentation_options'):
             return
@@ -657,14 +684,24 @@ class SymbioticCC(object):
 
         if hasattr(self._tool, 'passes_after_slicing'):
             passes += self._tool.passes_after_slicing()
+        if self.options.prune_checks:
+            passes.append('-prune-checks')
+        if self.options.hoist_checks:
+            passes.append('-hoist-checks')
         self.run_opt(passes)
 
         # link undefined functions at this point
         self.link_undefined()
 
+        # now we have the whole program, so globals that are used only
+        # in main (or a function called once) can become local variables
+        # that the optimizations promote to registers
+        if self.options.globals_to_locals:
+            self.run_opt(['-globals-to-locals'])
+
         # optimize the code after slicing and linking and before verification
         opt = get_optlist_after(self.options.optlevel)
-        self.optimize(passes=opt)
+        self.optimize(passes=opt, load_sbt=True)
 
         print_elapsed_time('INFO: After-slicing optimizations and transformations time',
                            color='WHITE')
@@ -752,6 +789,10 @@ class SymbioticCC(object):
         self._save_ll()
 
         self._get_stats('After compilation ')
+        if self.options.stats:
+            features = self.program_features()
+            if features:
+                print_stdout('INFO: Program features: {0}'.format(json.dumps(features)))
 
         if hasattr(self._tool, 'passes_after_compilation'):
             self.run_opt(self._tool.passes_after_compilation())
@@ -761,7 +802,11 @@ class SymbioticCC(object):
 
         # unroll the program if desired
         if self.options.unroll_count != 0:
-            self.run_opt(['-reg2mem', '-sbt-loop-unroll',
+            # compute the bounds of loops while the code is in SSA,
+            # the unrolling then uses them instead of the count if smaller
+            self.run_opt(['-mem2reg', '-classify-loops',
+                          '-classify-loops-annotate',
+                          '-reg2mem', '-sbt-loop-unroll',
                           '-sbt-loop-unroll-count',
                           str(self.options.unroll_count),
                           '-sbt-loop-unroll-terminate'])
@@ -779,6 +824,15 @@ class SymbioticCC(object):
         self.link_unconditional()
 
         passes = []
+        # drop the functions that cannot be called from main
+        # (e.g., the unused parts of the linked libraries),
+        # so that the rest of the passes do not need to process them
+        if self.options.remove_unreachable_functions:
+            passes.append('-remove-unreachable-functions')
+        # replace calls via pointers with direct calls where we can,
+        # so that the inliner, the instrumentation and the slicer see them
+        if self.options.devirtualize_calls:
+            passes.append('-devirtualize-calls')
         # NOTE: remove error calls must go first as the other passes
         # may include error calss
         prp = self.options.property
@@ -808,6 +862,9 @@ class SymbioticCC(object):
             passes.append('-mem2reg')
             passes.append('-break-crit-edges')
 
+        if hasattr(self._tool, 'passes_before_instrumentation'):
+            passes += self._tool.passes_before_instrumentation()
+
         self.run_opt(passes)
 
         #################### #################### ###################
@@ -829,6 +886,12 @@ class SymbioticCC(object):
             passes = self._tool.passes_after_instrumentation()
 
         if self.options.property.memsafety():
+            # remove the checks that are covered by other checks and merge
+            # the checks of the same object (we have such checks only
+            # when the whole state is instrumented into the program)
+            if self.options.full_instrumentation:
+                passes.append('-coalesce-checks')
+
             # replace llvm.lifetime.start/end with __VERIFIER_scope_enter/leave
             # so that optimizations will not mess the code up
             passes.append('-replace-lifetime-markers')
@@ -847,6 +910,11 @@ class SymbioticCC(object):
 
         # run optimizations if desired
         passes = get_optlist_before(self.options.optlevel)
+        # specialize the functions first, so that the optimizations
+        # clean up the clones. The arguments must be in registers,
+        # otherwise the pass does not see the branches on them
+        if self.options.specialize_calls:
+            passes = ['-mem2reg', '-specialize-calls'] + passes
         # Special optimizations for slicing.
         if not self.options.noslice and 'before-O3' in self.options.optlevel:
             # Break the infinite loops just before slicing so that the
@@ -857,8 +925,31 @@ class SymbioticCC(object):
                 passes += ['-reg2mem', '-break-infinite-loops',]
             passes += ['-remove-infinite-loops',
                        '-mem2reg', '-break-crit-loops', '-lowerswitch']
+        # removing the loops could hide non-termination
+        if self.options.accelerate_loops and \
+           not self.options.property.termination():
+            # -loop-idiom turns the loops that fill or copy memory
+            # into intrinsics, so that -accelerate-loops can remove them
+            passes += ['-mem2reg', '-loop-idiom', '-accelerate-loops']
         self.optimize(passes, load_sbt=True)
 
+        # the pass looks for the assumption right after the nondet call,
+        # so it needs the values in registers and the conditions
+        # with && and || turned into data flow by the optimizations
+        if self.options.fuse_nondet_assume:
+            self.run_opt(['-mem2reg', '-fuse-nondet-assume'])
+
+        # the code is in SSA now, remove the checks that are trivially safe
+        # so that they are not used as slicing criteria
+        if self.options.prune_checks:
+            self.run_opt(['-prune-checks'])
+
+        # define the undefined functions that we have summaries for,
+        # so that the slicer and the verifier see their side-effects
+        if self.options.undefined_summaries:
+            self.run_opt(['-model-undefined',
+                          '-model-undefined-summaries={0}'.format(self.options.undefined_summaries)])
+
         if hasattr(self._tool, 'actions_before_slicing'):
             self._tool.actions_before_slicing(self)
 
@@ -878,6 +969,18 @@ class SymbioticCC(object):
         self.link_undefined(['atexit', 'qsort'])
         self.run_opt(['-explicit-consdes', '-explicit-int-loads'])
 
+        # the constructors are explicit calls in main now,
+        # so the deterministic beginning of main can be evaluated.
+        # The evaluation turns heap objects into globals, so it cannot
+        # be used with memory safety. The allocations are evaluated
+        # only if they cannot fail
+        if self.options.evaluate_prefix and \
+           not (prp.memsafety() or prp.memcleanup()):
+            passes = ['-evaluate-main-prefix']
+            if self.options.malloc_never_fails:
+                passes.append('-evaluate-main-prefix-malloc-never-fails')
+            self.run_opt(passes)
+
         if not self.options.noslice:
             self.perform_slicing()
         elif self.options.require_slicer:
@@ -0,0 +1,18 @@
+#include "symbiotic-size_t.h"
+
+void __INSTR_check_nontermination(_Bool c);
+
+/* Check whether the state of the loop (stored in one buffer) is the same
+ * as the state in the previous iteration. The bytes are compared without
+ * branching, so the verifier gets one condition over the whole state. */
+void __INSTR_check_nontermination_mem(const void *state,
+                                      const void *snapshot, size_t size) {
+	const unsigned char *a = state;
+	const unsigned char *b = snapshot;
+	unsigned char diff = 0;
+
+	for (size_t i = 0; i < size; ++i)
+		diff |= a[i] ^ b[i];
+
+	__INSTR_check_nontermination(diff == 0);
+}
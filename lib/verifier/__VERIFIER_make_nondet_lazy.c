@@ -0,0 +1,13 @@
+#include "symbiotic-size_t.h"
+
+extern void __VERIFIER_make_nondet(void *mem, size_t size, const char *name);
+
+void __VERIFIER_make_nondet_lazy(void *mem, size_t size, const char *name,
+                                 char *initialized)
+{
+	if (*initialized)
+		return;
+
+	*initialized = 1;
+	__VERIFIER_make_nondet(mem, size, name);
+}
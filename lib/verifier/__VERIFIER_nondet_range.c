@@ -0,0 +1,24 @@
+extern unsigned char __VERIFIER_nondet_uchar(void);
+extern unsigned short __VERIFIER_nondet_ushort(void);
+extern unsigned int __VERIFIER_nondet_uint(void);
+extern unsigned long long __VERIFIER_nondet_ulonglong(void);
+extern void __VERIFIER_assume(int);
+
+/* return a non-deterministic value from [lo, lo + span],
+ * the non-deterministic value is only as wide as the range needs */
+unsigned long long __VERIFIER_nondet_range(unsigned long long lo,
+                                           unsigned long long span)
+{
+	unsigned long long x;
+	if (span <= 0xffULL)
+		x = __VERIFIER_nondet_uchar();
+	else if (span <= 0xffffULL)
+		x = __VERIFIER_nondet_ushort();
+	else if (span <= 0xffffffffULL)
+		x = __VERIFIER_nondet_uint();
+	else
+		x = __VERIFIER_nondet_ulonglong();
+
+	__VERIFIER_assume(x <= span);
+	return lo + x;
+}
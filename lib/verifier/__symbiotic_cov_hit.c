@@ -0,0 +1,33 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#define COV_BITMAP_BITS (1 << 16)
+
+/* The targets that were already hit in this run */
+static unsigned char __symbiotic_cov_bitmap[COV_BITMAP_BITS / 8];
+
+/* Record that the test target with the given id was hit.
+ * Every target is written into the coverage file (one id per line)
+ * the first time that it is hit, so that the file can be read
+ * while the tests are still being generated. */
+void __symbiotic_cov_hit(unsigned id)
+{
+	if (id < COV_BITMAP_BITS) {
+		unsigned char bit = 1 << (id % 8);
+		if (__symbiotic_cov_bitmap[id / 8] & bit)
+			return;
+		__symbiotic_cov_bitmap[id / 8] |= bit;
+	}
+
+	const char *path = getenv("SYMBIOTIC_COVERAGE_FILE");
+	FILE *f = fopen(path ? path : "symbiotic-coverage.txt", "a");
+	if (!f)
+		return;
+	fprintf(f, "__SYMBIOTIC_test_target%u\n", id);
+	fclose(f);
+}
+
+/* A native run always finishes its test, the hits are written immediately */
+void __symbiotic_cov_flush(void)
+{
+}
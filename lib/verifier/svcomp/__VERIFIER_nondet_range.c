@@ -0,0 +1,32 @@
+#include "symbiotic-size_t.h"
+
+extern void klee_make_symbolic(void *, size_t, const char *);
+extern void klee_assume(int);
+
+/* return a non-deterministic value from [lo, lo + span],
+ * the symbolic object is only as big as the range needs */
+unsigned long long __VERIFIER_nondet_range(unsigned long long lo,
+                                           unsigned long long span)
+{
+	if (span <= 0xffULL) {
+		unsigned char x;
+		klee_make_symbolic(&x, sizeof(x), "nondet-range");
+		klee_assume(x <= span);
+		return lo + x;
+	} else if (span <= 0xffffULL) {
+		unsigned short x;
+		klee_make_symbolic(&x, sizeof(x), "nondet-range");
+		klee_assume(x <= span);
+		return lo + x;
+	} else if (span <= 0xffffffffULL) {
+		unsigned int x;
+		klee_make_symbolic(&x, sizeof(x), "nondet-range");
+		klee_assume(x <= span);
+		return lo + x;
+	} else {
+		unsigned long long x;
+		klee_make_symbolic(&x, sizeof(x), "nondet-range");
+		klee_assume(x <= span);
+		return lo + x;
+	}
+}
@@ -0,0 +1,55 @@
+#define COV_BITMAP_BITS (1 << 16)
+
+extern void klee_warning(const char *);
+/* Defined by -get-test-targets-bitmap, calls __symbiotic_cov_covered
+ * with the name of the target */
+extern void __symbiotic_cov_report(unsigned id);
+
+/* The targets that were already hit on this path */
+static unsigned char __symbiotic_cov_bitmap[COV_BITMAP_BITS / 8];
+/* The number of the bytes of the bitmap that contain a hit */
+static unsigned __symbiotic_cov_bytes;
+
+/* Record that the test target with the given id was hit on this path.
+ * The hit is reported only when the path ends (__symbiotic_cov_flush),
+ * so the targets hit by paths that are killed before they write
+ * a test are not considered covered. */
+void __symbiotic_cov_hit(unsigned id)
+{
+	if (id >= COV_BITMAP_BITS)
+		return;
+
+	unsigned char bit = 1 << (id % 8);
+	if (__symbiotic_cov_bitmap[id / 8] & bit)
+		return;
+	__symbiotic_cov_bitmap[id / 8] |= bit;
+	if (id / 8 >= __symbiotic_cov_bytes)
+		__symbiotic_cov_bytes = id / 8 + 1;
+}
+
+/* Report the targets hit by the path, called right before the path ends */
+void __symbiotic_cov_flush(void)
+{
+	for (unsigned i = 0; i < __symbiotic_cov_bytes; ++i) {
+		unsigned char byte = __symbiotic_cov_bitmap[i];
+		for (unsigned b = 0; byte != 0; ++b, byte >>= 1) {
+			if (byte & 1)
+				__symbiotic_cov_report(8 * i + b);
+		}
+	}
+}
+
+/* KLEE prints the warnings of all paths into warnings.txt in the output
+ * directory, so we use it as the coverage bitmap that is shared between
+ * the paths (kleetester drops the duplicate reports). klee_warning_once
+ * would not do, it prints only the first message of the call site. */
+void __symbiotic_cov_covered(const char *name)
+{
+	char msg[64] = "covered ";
+	unsigned i = sizeof("covered ") - 1;
+	while (*name && i < sizeof(msg) - 1)
+		msg[i++] = *name++;
+	msg[i] = '\0';
+
+	klee_warning(msg);
+}
@@ -2,6 +2,9 @@
 from subprocess import Popen, PIPE, STDOUT
 from time import sleep
 from sys import stderr
+from glob import glob
+from shutil import move, rmtree
+import re
 
 def runcmd(cmd):
     print("[kleetester] {0}".format(" ".join(cmd)), file=stderr)
@@ -59,6 +62,47 @@ def find_criterions(bitcode):
         return newbitcode, (crit.decode('utf-8', 'ignore') for crit in out.splitlines())
     return None, None
 
+def read_criterions(targetsfile):
+    """ Read the targets found by -get-test-targets-bitmap """
+    targets = []
+    with open(targetsfile, 'r') as f:
+        for line in f:
+            parts = line.split()
+            if not parts:
+                continue
+            depth = int(parts[1]) if len(parts) > 1 else 0
+            targets.append((parts[0], depth))
+    # the deeper targets are less likely to be covered by the main KLEE
+    targets.sort(key=lambda t: t[1], reverse=True)
+    return [t[0] for t in targets]
+
+covered_re = re.compile(r'covered (__SYMBIOTIC_test_target[0-9]+)')
+
+def update_covered(outdir, covered):
+    """
+    Add the targets that are covered by the tests of the main KLEE.
+    The paths report the targets that they hit via klee_warning
+    (i.e., into warnings.txt) when they end, so the paths that are killed
+    before writing a test do not report anything. A target is reported
+    by every path that hits it, the set keeps it once. The side KLEEs run
+    in their own output directories, so nobody else writes to the file.
+    """
+    try:
+        with open(f'{outdir}/warnings.txt', 'r', errors='ignore') as f:
+            for line in f:
+                m = covered_re.search(line)
+                if m:
+                    covered.add(m.group(1))
+    except OSError:
+        pass
+    return covered
+
+def collect_tests(rundir, outdir):
+    """ Move the tests generated by a side KLEE into the output directory """
+    for test in glob(f'{rundir}/test*.xml'):
+        move(test, outdir)
+    rmtree(rundir, ignore_errors=True)
+
 def constrain_to_target(bitcode, target):
     newbitcode = f"{bitcode}.opt.bc"
     cmd = ['opt', '-load', 'LLVMsbt.so', '-constraint-to-target',
@@ -100,13 +144,18 @@ def check_error(outs, errs):
     return False
 
 def main(argv):
-    if len(argv) != 4:
+    if len(argv) not in (4, 5):
         exit(1)
     prp = argv[1]
     outdir = argv[2]
     bitcode = argv[3]
+    # the bitcode already contains the targets that record their coverage
+    targetsfile = argv[4] if len(argv) == 5 else None
+    covered = set()
 
     generators = []
+    # the output directories of the side KLEEs
+    rundirs = {}
 
     # run KLEE on the original bitcode
     print("\n--- Running the main KLEE --- ", file=stderr)
@@ -114,13 +163,20 @@ def main(argv):
     if maingen:
         generators.append(maingen)
 
-    bitcodewithcrits, crits = find_criterions(bitcode)
+    if targetsfile:
+        bitcodewithcrits, crits = bitcode, read_criterions(targetsfile)
+    else:
+        bitcodewithcrits, crits = find_criterions(bitcode)
+        if bitcodewithcrits:
+            # The later crits are likely deeper in the code.
+            # Since run use only part of them, use those.
+            crits = list(crits)
+            crits.reverse()
     if bitcodewithcrits:
-        # The later crits are likely deeper in the code.
-        # Since run use only part of them, use those.
-        crits = list(crits)
-        crits.reverse()
         for n, crit in enumerate(crits):
+            if targetsfile and crit in update_covered(outdir, covered):
+                print(f"Target {crit} is already covered", file=stderr)
+                continue
             print(f"\n--- Targeting at {crit} target --- ", file=stderr)
             if prp == 'coverage' and maingen and maingen.poll() is not None:
                 break # the main process finished, we can finish too
@@ -150,15 +206,22 @@ def main(argv):
             # generate tests
             if prp == 'coverage' and maingen and maingen.poll() is not None:
                 break # the main process finished, we can finish too
-            p = gentest(slicedcode, outdir, prp, suffix=str(n),
+            # every side KLEE has its own output directory, so that it does
+            # not overwrite the files of the main KLEE (e.g., warnings.txt),
+            # its tests are moved to the output directory when it finishes
+            rundir = f'{outdir}-klee{n}'
+            p = gentest(slicedcode, rundir, prp, suffix=str(n),
                         params=['--search=dfs', '--use-batching-search'])
             if p is None:
                 continue
             generators.append(p)
+            rundirs[p] = rundir
 
             newgens = []
             for p in generators:
                 if p.poll() is not None:
+                    if p in rundirs:
+                        collect_tests(rundirs.pop(p), outdir)
                     if prp != 'coverage':
                         if check_error(*p.communicate()):
                             for gen in generators:
@@ -179,6 +242,8 @@ def main(argv):
                 sleep(2) # sleep 2 seconds
                 for p in generators:
                     if p.poll() is not None:
+                        if p in rundirs:
+                            collect_tests(rundirs.pop(p), outdir)
                         if prp != 'coverage':
                             if check_error(*p.communicate()):
                                 for gen in generators:
@@ -199,6 +264,8 @@ def main(argv):
         newgens = []
         for p in generators:
             if p.poll() is not None:
+                if p in rundirs:
+                    collect_tests(rundirs.pop(p), outdir)
                 if prp != 'coverage':
                     if check_error(*p.communicate()):
                         for gen in generators:
@@ -212,6 +279,13 @@ def main(argv):
             sleep(2) # sleep 2 seconds
 
     print(f"\n--- All KLEE finished --- ", file=stderr)
+    if targetsfile:
+        update_covered(outdir, covered)
+        if covered.issuperset(crits):
+            print("The main KLEE covered all the targets", file=stderr)
+        else:
+            print(f"The main KLEE covered {len(covered)} of {len(crits)} targets",
+                  file=stderr)
 
     if prp == 'coverage':
         # if all finished, then also the main KLEE finished,
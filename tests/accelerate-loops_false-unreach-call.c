@@ -0,0 +1,18 @@
+// OPTIONS: --accelerate-loops --optimize=after-O3 --debug=compile
+// OUTPUT: Accelerated a loop in main
+
+// The loop may run 2^32 times and it is replaced with s = 3 * n,
+// which is not always the value that the assertion expects.
+
+extern void __VERIFIER_assert(int);
+extern unsigned __VERIFIER_nondet_uint(void);
+
+int main(void) {
+	unsigned n = __VERIFIER_nondet_uint();
+	unsigned s = 0;
+	for (unsigned i = 0; i < n; ++i)
+		s += 3;
+
+	__VERIFIER_assert(s != 3000000);
+	return 0;
+}
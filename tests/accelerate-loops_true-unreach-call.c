@@ -0,0 +1,19 @@
+// OPTIONS: --accelerate-loops --optimize=after-O3 --debug=compile
+// OUTPUT: Accelerated a loop in main
+
+// The loop may run 2^32 times, the verifier finishes only if it is
+// replaced with s = 3 * n. The optimizations before slicing are off,
+// so that they do not compute the result of the loop themselves.
+
+extern void __VERIFIER_assert(int);
+extern unsigned __VERIFIER_nondet_uint(void);
+
+int main(void) {
+	unsigned n = __VERIFIER_nondet_uint();
+	unsigned s = 0;
+	for (unsigned i = 0; i < n; ++i)
+		s += 3;
+
+	__VERIFIER_assert(s == 3 * n);
+	return 0;
+}
@@ -0,0 +1,32 @@
+// OPTIONS: --full-instrumentation
+// OUTPUT: redundant checks and merged
+
+// The merged check of the fields of *s must still catch
+// the access to s->c that is out of the object.
+
+#include <stdlib.h>
+
+extern int __VERIFIER_nondet_int(void);
+
+struct S {
+	int a;
+	int b;
+	int c;
+};
+
+int sum(struct S *s) {
+	return s->a + s->b + s->c;
+}
+
+int main(void) {
+	struct S *s = malloc(2 * sizeof(int));
+	if (!s)
+		return 0;
+
+	s->a = __VERIFIER_nondet_int();
+	s->b = __VERIFIER_nondet_int();
+
+	int r = sum(s);
+	free(s);
+	return r;
+}
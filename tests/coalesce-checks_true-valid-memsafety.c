@@ -0,0 +1,32 @@
+// OPTIONS: --full-instrumentation
+// OUTPUT: redundant checks and merged
+
+// The accesses to the fields of *s are checked together by one check.
+
+#include <stdlib.h>
+
+extern int __VERIFIER_nondet_int(void);
+
+struct S {
+	int a;
+	int b;
+	int c;
+};
+
+int sum(struct S *s) {
+	return s->a + s->b + s->c;
+}
+
+int main(void) {
+	struct S *s = malloc(sizeof(struct S));
+	if (!s)
+		return 0;
+
+	s->a = __VERIFIER_nondet_int();
+	s->b = __VERIFIER_nondet_int();
+	s->c = __VERIFIER_nondet_int();
+
+	int r = sum(s);
+	free(s);
+	return r;
+}
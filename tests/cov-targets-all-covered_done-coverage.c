@@ -0,0 +1,18 @@
+// OPTIONS: --test-comp --debug=all
+// OUTPUT: The main KLEE covered all the targets
+
+// Every path ends in another test target and reports it only when it ends,
+// so the main KLEE must report all of them, not only the first one.
+
+#include <stdlib.h>
+
+extern int __VERIFIER_nondet_int(void);
+
+int main(void) {
+	int x = __VERIFIER_nondet_int();
+	if (x == 1)
+		abort();
+	if (x == 2)
+		exit(0);
+	return 0;
+}
@@ -0,0 +1,22 @@
+// OPTIONS: --devirtualize-calls --debug=prepare
+// OUTPUT: calls via pointer
+
+// The call via the pointer becomes a choice between direct calls,
+// the error in one of the targets must still be found.
+
+extern void __VERIFIER_assert(int);
+extern int __VERIFIER_nondet_int(void);
+
+int inc(int x) {
+	return x + 1;
+}
+
+int dec(int x) {
+	return x - 1;
+}
+
+int main(void) {
+	int (*op)(int) = __VERIFIER_nondet_int() ? inc : dec;
+	__VERIFIER_assert(op(0) == 1);
+	return 0;
+}
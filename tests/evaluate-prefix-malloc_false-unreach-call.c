@@ -0,0 +1,25 @@
+// OPTIONS: --evaluate-prefix
+
+// malloc may fail, so its call in the prefix of main
+// must not be evaluated as a successful allocation.
+
+#include <stdlib.h>
+
+extern int __VERIFIER_nondet_int(void);
+extern void __VERIFIER_assert(int);
+
+int *p;
+
+void init(void) {
+	p = malloc(sizeof(int));
+}
+
+int main(void) {
+	init();
+
+	int x = __VERIFIER_nondet_int();
+	__VERIFIER_assert(p != NULL);
+	if (p)
+		*p = x;
+	return 0;
+}
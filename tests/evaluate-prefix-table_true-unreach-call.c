@@ -0,0 +1,25 @@
+// OPTIONS: --evaluate-prefix
+
+// The initialization of a large table is evaluated at compile time.
+
+extern unsigned __VERIFIER_nondet_uint(void);
+extern void __VERIFIER_assume(int);
+extern void __VERIFIER_assert(int);
+
+#define N 20000
+
+unsigned table[N];
+
+void init(void) {
+	for (unsigned i = 0; i < N; ++i)
+		table[i] = 2 * i;
+}
+
+int main(void) {
+	init();
+
+	unsigned x = __VERIFIER_nondet_uint();
+	__VERIFIER_assume(x < N);
+	__VERIFIER_assert(table[x] == 2 * x);
+	return 0;
+}
@@ -0,0 +1,18 @@
+// OPTIONS: --fuse-nondet-assume
+
+// The assumption is on x + y, not on x alone, so it must not
+// be turned into a range of x.
+
+extern int __VERIFIER_nondet_int(void);
+extern void __VERIFIER_assume(int);
+extern void __VERIFIER_assert(int);
+
+int main(void) {
+	int y = __VERIFIER_nondet_int();
+	__VERIFIER_assume(y >= -10 && y <= 0);
+	int x = __VERIFIER_nondet_int();
+	__VERIFIER_assume(x + y < 10);
+
+	__VERIFIER_assert(x < 10);
+	return 0;
+}
@@ -0,0 +1,19 @@
+// OPTIONS: --globals-to-locals
+
+// The global keeps the allocated memory reachable until the program
+// exits, so it must not become a local variable of main.
+
+#include <stdlib.h>
+
+extern _Bool __VERIFIER_nondet_bool();
+
+char *g;
+
+int main() {
+	g = malloc(10);
+	if (__VERIFIER_nondet_bool())
+		exit(0);
+
+	free(g);
+	return 0;
+}
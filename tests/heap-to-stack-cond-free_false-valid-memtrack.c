@@ -0,0 +1,19 @@
+// OPTIONS: --full-instrumentation
+
+// The free does not post-dominate the allocation, so the memory leaks
+// on one of the paths and it must stay on the heap.
+
+#include <stdlib.h>
+
+extern int __VERIFIER_nondet_int(void);
+
+int main(void) {
+	int *p = malloc(sizeof(int));
+	if (!p)
+		return 0;
+
+	*p = 1;
+	if (__VERIFIER_nondet_int())
+		free(p);
+	return 0;
+}
@@ -0,0 +1,21 @@
+// OPTIONS: --full-instrumentation
+
+// The allocation is in a loop and only the last object is freed,
+// a stack slot would be reused by all the iterations and hide the leak.
+
+#include <stdlib.h>
+
+extern int __VERIFIER_nondet_int(void);
+
+int main(void) {
+	int *p = NULL;
+	for (int i = 0; i < 2; ++i) {
+		p = malloc(sizeof(int));
+		if (!p)
+			return 0;
+		*p = i;
+	}
+
+	free(p);
+	return 0;
+}
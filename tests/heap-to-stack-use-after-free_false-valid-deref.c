@@ -0,0 +1,18 @@
+// OPTIONS: --full-instrumentation
+
+// The memory is used after it is freed, so it must stay on the heap
+// (on the stack, the use would be valid).
+
+#include <stdlib.h>
+
+extern int __VERIFIER_nondet_int(void);
+
+int main(void) {
+	int *p = malloc(sizeof(int));
+	if (!p)
+		return 0;
+
+	*p = __VERIFIER_nondet_int();
+	free(p);
+	return *p;
+}
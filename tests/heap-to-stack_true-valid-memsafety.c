@@ -0,0 +1,22 @@
+// OPTIONS: --full-instrumentation --debug=prepare
+// OUTPUT: Promoted 1 heap allocations to stack in main
+
+// The allocation does not escape and it is freed exactly once,
+// so -heap-to-stack puts it on the stack before the instrumentation.
+
+#include <stdlib.h>
+
+extern int __VERIFIER_nondet_int(void);
+
+int main(void) {
+	int *p = malloc(4 * sizeof(int));
+	if (!p)
+		return 0;
+
+	for (int i = 0; i < 4; ++i)
+		p[i] = __VERIFIER_nondet_int();
+
+	int sum = p[0] + p[3];
+	free(p);
+	return sum;
+}
@@ -0,0 +1,21 @@
+// OPTIONS: --hoist-checks --debug=prepare
+// OUTPUT: Hoisted 1 checks from a loop in main
+
+// The assertion does not depend on the loop, it is checked once before
+// the loop, at its original place.
+
+extern void __VERIFIER_assert(int);
+extern int __VERIFIER_nondet_int(void);
+
+int main(void) {
+	int n = __VERIFIER_nondet_int();
+	int k = __VERIFIER_nondet_int();
+
+	int i = 0;
+	do {
+		__VERIFIER_assert(k != 5);
+		++i;
+	} while (i < n);
+
+	return 0;
+}
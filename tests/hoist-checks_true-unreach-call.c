@@ -0,0 +1,24 @@
+// OPTIONS: --hoist-checks --debug=prepare
+// OUTPUT: Hoisted 1 checks from a loop in main
+
+// The assertion does not depend on the loop, it is checked once before
+// the loop and the loop then does nothing. Otherwise the verifier would
+// check it in up to 2^31 iterations.
+
+extern void __VERIFIER_assert(int);
+extern void __VERIFIER_assume(int);
+extern int __VERIFIER_nondet_int(void);
+
+int main(void) {
+	int n = __VERIFIER_nondet_int();
+	int k = __VERIFIER_nondet_int();
+	__VERIFIER_assume(k < 5);
+
+	int i = 0;
+	do {
+		__VERIFIER_assert(k != 5);
+		++i;
+	} while (i < n);
+
+	return 0;
+}
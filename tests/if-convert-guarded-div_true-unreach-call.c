@@ -0,0 +1,26 @@
+// OPTIONS: --optimize=before-O3,after-klee
+
+// The branch that guards the call of div must not be flattened,
+// the function is pure, but it is undefined for b == 0.
+
+extern int __VERIFIER_nondet_int(void);
+extern void __VERIFIER_assume(int);
+extern void __VERIFIER_assert(int);
+
+__attribute__((const, noinline))
+static int div(int a, int b) {
+	return a / b;
+}
+
+int main(void) {
+	int a = __VERIFIER_nondet_int();
+	int b = __VERIFIER_nondet_int();
+	__VERIFIER_assume(a >= 0 && a <= 100);
+
+	int r = 0;
+	if (b > 0)
+		r = div(a, b);
+
+	__VERIFIER_assert(r >= 0);
+	return 0;
+}
@@ -0,0 +1,19 @@
+// OPTIONS: --debug=prepare
+// OUTPUT: Instrumented a loop with non-termination checks
+
+// The loop changes g only via the call, the summary of tick() tells
+// that g is the state of the loop. It stops changing at 10.
+
+int g;
+
+void tick(void) {
+	if (g < 10)
+		++g;
+}
+
+int main(void) {
+	while (g < 20)
+		tick();
+
+	return 0;
+}
@@ -0,0 +1,20 @@
+// OPTIONS: --debug=prepare --nontermination-snapshot=2
+// OUTPUT: Instrumented a loop with non-termination checks (snapshot of
+
+// Both variables of the loop stop changing at 10, the state in
+// the snapshot is then the same as the state after the iteration.
+
+extern int __VERIFIER_nondet_int(void);
+
+int main(void) {
+	int x = __VERIFIER_nondet_int();
+	int y = __VERIFIER_nondet_int();
+	while (x > 0) {
+		if (x < 10)
+			++x;
+		if (y < 10)
+			++y;
+	}
+
+	return 0;
+}
@@ -0,0 +1,17 @@
+// OPTIONS: --debug=prepare --nontermination-snapshot=2
+// OUTPUT: Instrumented a loop with non-termination checks (snapshot of
+
+// The state of the loop changes in every iteration.
+
+extern int __VERIFIER_nondet_int(void);
+
+int main(void) {
+	int x = __VERIFIER_nondet_int();
+	int y = __VERIFIER_nondet_int();
+	while (x > 0 && x < 10) {
+		++x;
+		y += x;
+	}
+
+	return y;
+}
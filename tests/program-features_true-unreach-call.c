@@ -0,0 +1,25 @@
+// OPTIONS: --statistics
+// OUTPUT: INFO: Program features:
+// OUTPUT: "max_depth": 2
+
+// The features of the program are computed after compilation
+// and they do not change the verdict.
+
+#include <stdlib.h>
+
+extern void __VERIFIER_assert(int);
+
+int main(void) {
+	int *a = malloc(4 * sizeof(int));
+	if (!a)
+		return 0;
+
+	int sum = 0;
+	for (int i = 0; i < 2; ++i)
+		for (int j = 0; j < 2; ++j)
+			sum += i + j;
+
+	free(a);
+	__VERIFIER_assert(sum == 4);
+	return 0;
+}
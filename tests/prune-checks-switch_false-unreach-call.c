@@ -0,0 +1,27 @@
+// OPTIONS: --prune-checks
+
+// The interval analysis must not consider the default branch
+// of a switch infeasible when the cases only bracket the range
+// of the condition.
+
+extern int __VERIFIER_nondet_int(void);
+extern void __VERIFIER_assume(int);
+extern void __VERIFIER_assert(int);
+
+int main(void) {
+	int x = __VERIFIER_nondet_int();
+	__VERIFIER_assume(x >= 0 && x <= 10);
+
+	int r;
+	switch (x) {
+	case 0:
+	case 10:
+		r = 1;
+		break;
+	default:
+		r = 0;
+	}
+
+	__VERIFIER_assert(r);
+	return 0;
+}
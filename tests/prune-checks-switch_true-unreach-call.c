@@ -0,0 +1,27 @@
+// OPTIONS: --prune-checks
+
+// All values of x are covered by the cases,
+// so the default branch is infeasible.
+
+extern int __VERIFIER_nondet_int(void);
+extern void __VERIFIER_assume(int);
+extern void __VERIFIER_assert(int);
+
+int main(void) {
+	int x = __VERIFIER_nondet_int();
+	__VERIFIER_assume(x >= 0 && x <= 2);
+
+	int r;
+	switch (x) {
+	case 0:
+	case 1:
+	case 2:
+		r = 1;
+		break;
+	default:
+		r = 0;
+	}
+
+	__VERIFIER_assert(r);
+	return 0;
+}
@@ -0,0 +1,20 @@
+// OUTPUT: Removed infinite loop in main
+
+// The paths with x > 10 hang in a cycle (of more than one block) that
+// does nothing. Without removing it, the verifier would never finish.
+
+extern void __VERIFIER_assert(int);
+extern int __VERIFIER_nondet_int(void);
+
+int main(void) {
+	int x = __VERIFIER_nondet_int();
+	if (x > 10) {
+		for (;;) {
+			if (x > 20)
+				continue;
+		}
+	}
+
+	__VERIFIER_assert(x <= 10);
+	return 0;
+}
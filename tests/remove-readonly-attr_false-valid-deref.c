@@ -0,0 +1,19 @@
+// OPTIONS: --debug=prepare
+// OUTPUT: Dropped 'readonly' from
+
+// The result of the pure functions is unused, so LLVM would drop their
+// calls together with the invalid read if they stayed read-only.
+
+__attribute__((pure)) static int get(const int *a, int i) {
+	return a[i];
+}
+
+__attribute__((pure)) static int get_last(const int *a, int n) {
+	return get(a, n);
+}
+
+int main(void) {
+	int a[2] = {1, 2};
+	get_last(a, 2);
+	return 0;
+}
@@ -0,0 +1,24 @@
+// OPTIONS: --remove-unreachable-functions
+// OUTPUT: unreachable functions (
+
+// The function with the error is called only through a pointer,
+// so it must be kept, while the other one is removed.
+
+extern void __VERIFIER_error(void) __attribute__((noreturn));
+extern int __VERIFIER_nondet_int(void);
+
+void unused(void) {
+	__VERIFIER_error();
+}
+
+void check(int x) {
+	if (x > 0)
+		__VERIFIER_error();
+}
+
+void (*handler)(int) = check;
+
+int main(void) {
+	handler(__VERIFIER_nondet_int());
+	return 0;
+}
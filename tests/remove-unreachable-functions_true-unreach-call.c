@@ -0,0 +1,17 @@
+// OPTIONS: --remove-unreachable-functions
+// OUTPUT: unreachable functions (
+
+// The only error is in a function that cannot be called from main.
+
+extern void __VERIFIER_error(void) __attribute__((noreturn));
+extern int __VERIFIER_nondet_int(void);
+
+void unused(int x) {
+	if (x > 0)
+		__VERIFIER_error();
+}
+
+int main(void) {
+	int x = __VERIFIER_nondet_int();
+	return x > 0;
+}
@@ -0,0 +1,18 @@
+// OPTIONS: --debug=prepare
+// OUTPUT: Dropped the scope markers of
+
+// The markers of x are dropped, but the markers of y, whose address
+// escapes, are kept and the use after its scope is found.
+
+extern int __VERIFIER_nondet_int(void);
+
+int main(void) {
+	int *p = 0;
+	for (int i = 0; i < 4; ++i) {
+		int x = __VERIFIER_nondet_int();
+		int y = x;
+		p = &y;
+	}
+
+	return *p;
+}
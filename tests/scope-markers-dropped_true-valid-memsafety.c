@@ -0,0 +1,17 @@
+// OPTIONS: --debug=prepare
+// OUTPUT: Dropped the scope markers of
+
+// The address of x never escapes, so it cannot be used out of its scope
+// and -replace-lifetime-markers drops its markers.
+
+extern int __VERIFIER_nondet_int(void);
+
+int main(void) {
+	int sum = 0;
+	for (int i = 0; i < 4; ++i) {
+		int x = __VERIFIER_nondet_int();
+		sum += x;
+	}
+
+	return sum;
+}
@@ -0,0 +1,22 @@
+// OPTIONS: --specialize-calls --debug=compile
+// OUTPUT: Specialized
+
+// The calls with a constant mode get their own clones of process()
+// without the branches for the other modes.
+
+extern void __VERIFIER_assert(int);
+extern unsigned __VERIFIER_nondet_uint(void);
+
+unsigned process(unsigned x, int mode) {
+	if (mode == 0)
+		return x + 1;
+	if (mode == 1)
+		return x - 1;
+	return 2 * x;
+}
+
+int main(void) {
+	unsigned x = __VERIFIER_nondet_uint();
+	__VERIFIER_assert(process(x, 2) != 10);
+	return 0;
+}
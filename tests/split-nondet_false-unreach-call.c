@@ -0,0 +1,20 @@
+// OPTIONS: --split-nondet=32 --debug=prepare
+// OUTPUT: Split the symbolic object
+
+// Every field of the uninitialized struct is a separate symbolic
+// object, all of them must be able to take any value.
+
+extern void __VERIFIER_assert(int);
+
+struct S {
+	int a;
+	char b;
+	long c;
+};
+
+int main(void) {
+	struct S s;
+
+	__VERIFIER_assert(!(s.a == 5 && s.b == 'x' && s.c == 7));
+	return 0;
+}
@@ -0,0 +1,21 @@
+// OPTIONS: --split-nondet=32 --debug=prepare
+// OUTPUT: Split the symbolic object
+
+// The fields of the uninitialized struct are copied from separate
+// symbolic objects, a copy of the struct must have the same values.
+
+extern void __VERIFIER_assert(int);
+
+struct S {
+	int a;
+	char b;
+	long c;
+};
+
+int main(void) {
+	struct S s;
+	struct S t = s;
+
+	__VERIFIER_assert(t.a == s.a && t.b == s.b && t.c == s.c);
+	return 0;
+}
@@ -0,0 +1,14 @@
+// OPTIONS: --symbolic-undefined --debug=prepare
+// OUTPUT: Made symbolic 1 of 4 bytes of the result of get_flags
+
+// Only the lowest byte of the result of get_flags() is used,
+// so only that byte is symbolic. It still may be 255.
+
+extern void __VERIFIER_assert(int);
+extern int get_flags(void);
+
+int main(void) {
+	unsigned char low = get_flags();
+	__VERIFIER_assert(low != 255);
+	return 0;
+}
@@ -38,10 +38,45 @@ def get_expected_result(input_regex):
     if 'true' in input_regex:
         return 'true'
 
+    # the generation of tests has no verdict
+    if 'done' in input_regex:
+        return 'done'
+
     # *false-valid-memtrack* -> |prefix| = 7 and |suffix| = 1
     return 'false(%s)' % input_regex[7:-1]
 
 
+def get_test_options(test):
+    """
+    Get the additional options of Symbiotic for the test, i.e., the options
+    from the lines of the form '// OPTIONS: --opt1 --opt2' in the test file.
+    """
+    opts = []
+    with open(test, 'r', errors='ignore') as f:
+        for line in f:
+            line = line.strip()
+            if line.startswith('// OPTIONS:'):
+                opts += line[len('// OPTIONS:'):].split()
+
+    return opts
+
+
+def get_test_outputs(test):
+    """
+    Get the messages that Symbiotic must print for the test, i.e., the
+    messages from the lines of the form '// OUTPUT: message' in the test
+    file. With '// OPTIONS: --debug=prepare' they check that a pass fired.
+    """
+    outputs = []
+    with open(test, 'r', errors='ignore') as f:
+        for line in f:
+            line = line.strip()
+            if line.startswith('// OUTPUT:'):
+                outputs.append(line[len('// OUTPUT:'):].strip())
+
+    return outputs
+
+
 def run_tests(test_files, prp, expected_result, args):
     global failure
 
@@ -51,22 +86,25 @@ def run_tests(test_files, prp, expected_result, args):
     if prp != 'reach':
         cmd.append('--prp=' + prp)
 
-    if args.debug:
-        cmd.append('--debug=all')
-
     if args.is32bit:
         cmd.append('--32')
 
     if not args.with_integrity_check:
         cmd.append('--no-integrity-check')
 
+    # after the options of the tests, so that it is not overridden
+    debug = ['--debug=all'] if args.debug else []
+
     for test in test_files:
         print(test, end=': ')
 
-        symbiotic = Popen(cmd + [test], stdout=PIPE, stderr=PIPE)
+        symbiotic = Popen(cmd + get_test_options(test) + debug + [test],
+                          stdout=PIPE, stderr=PIPE)
         out, err = map(lambda x: x.decode(), symbiotic.communicate())
+        missing = [o for o in get_test_outputs(test) if o not in out + err]
 
-        if expected_result in out and symbiotic.returncode == 0:
+        if expected_result in out and symbiotic.returncode == 0 and \
+           not missing:
             print('PASS', color=GREEN)
             continue
 
@@ -84,6 +122,8 @@ def run_tests(test_files, prp, expected_result, args):
 
         print('\tExpected result:', expected_result)
         print('\tActual result:', match[0] if match else 'N/A')
+        for o in missing:
+            print('\tMissing output:', o)
 
         print('\nstdout:')
         print(out)
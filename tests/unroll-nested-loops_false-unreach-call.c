@@ -0,0 +1,22 @@
+// OPTIONS: --unroll=10
+
+// The inner loop shares its latch with the outer loop (after CFG
+// simplification). The bound of the outer loop must not be used
+// for the unbounded inner loop when unrolling.
+
+extern int __VERIFIER_nondet_int(void);
+extern void __VERIFIER_assert(int);
+
+int main(void) {
+	int i = 0, j = 0;
+	while (i < 3) {
+		++i;
+		j = 0;
+		do {
+			++j;
+		} while (__VERIFIER_nondet_int());
+	}
+
+	__VERIFIER_assert(j < 6);
+	return 0;
+}
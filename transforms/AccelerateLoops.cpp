@@ -0,0 +1,165 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <vector>
+
+#include "llvm/Analysis/LoopPass.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+#if LLVM_VERSION_MAJOR >= 12
+  #include "llvm/Transforms/Utils/ScalarEvolutionExpander.h"
+#else
+  #include "llvm/Analysis/ScalarEvolutionExpander.h"
+#endif
+
+using namespace llvm;
+
+// Replace loops that only compute values (no memory writes, no calls,
+// no instructions that may fail) and that have a computable number
+// of iterations with the closed form of the values that the loop
+// computes, e.g.,
+//
+//   for (i = 0; i < n; ++i) s += k;   -->   s = s + n*k; i = n;
+//
+// The closed forms are given by ScalarEvolution, so affine and
+// polynomial recurrences are handled. The loops that write memory
+// are not accelerated by this pass, but run -loop-idiom before it
+// to turn the memset- and memcpy-like loops into intrinsics, after
+// which the loops become pure and can be removed by this pass.
+// A loop with an assertion (a call) is never accelerated.
+//
+// NOTE: the pass removes the loops whose number of iterations
+// is computable, so it must not be used for checking termination.
+namespace {
+
+class AccelerateLoops : public LoopPass {
+  static bool isPure(const Loop *L);
+
+public:
+  static char ID;
+
+  AccelerateLoops() : LoopPass(ID) {}
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    getLoopAnalysisUsage(AU);
+  }
+
+  bool runOnLoop(Loop *L, LPPassManager &LPM) override;
+};
+
+// Has the loop any effect apart from the values that it computes?
+bool AccelerateLoops::isPure(const Loop *L) {
+  for (auto *B : L->blocks()) {
+    for (auto& I : *B) {
+      if (isa<PHINode>(&I) || isa<DbgInfoIntrinsic>(&I))
+        continue;
+      if (I.isTerminator()) {
+        if (!isa<BranchInst>(&I) && !isa<SwitchInst>(&I))
+          return false;
+        continue;
+      }
+      // isSafeToSpeculativelyExecute excludes also
+      // loads of invalid pointers and divisions by zero
+      if (I.mayHaveSideEffects() || !isSafeToSpeculativelyExecute(&I))
+        return false;
+    }
+  }
+
+  return true;
+}
+
+bool AccelerateLoops::runOnLoop(Loop *L, LPPassManager &LPM) {
+#if LLVM_VERSION_MAJOR >= 8
+  if (!L->getSubLoops().empty())
+    return false;
+
+  BasicBlock *preheader = L->getLoopPreheader();
+  BasicBlock *exit = L->getUniqueExitBlock();
+  BasicBlock *exiting = L->getExitingBlock();
+  if (!preheader || !exit || !exiting)
+    return false;
+
+  const auto& fname = preheader->getParent()->getName();
+  if (fname.startswith("__VERIFIER_") || fname.startswith("__INSTR_"))
+    return false;
+
+  if (!isPure(L))
+    return false;
+
+  auto& SE = getAnalysis<ScalarEvolutionWrapperPass>().getSE();
+  auto& DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  auto& LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+
+  if (isa<SCEVCouldNotCompute>(SE.getBackedgeTakenCount(L)))
+    return false;
+
+  // the values that leave the loop (the loop is in LCSSA form,
+  // so they all go through the PHI nodes of the exit block)
+  Instruction *insertPt = preheader->getTerminator();
+  std::vector<std::pair<PHINode *, const SCEV *>> exitValues;
+  for (auto& I : *exit) {
+    auto *PHI = dyn_cast<PHINode>(&I);
+    if (!PHI)
+      break;
+
+    Value *V = PHI->getIncomingValueForBlock(exiting);
+    if (auto *VI = dyn_cast<Instruction>(V)) {
+      if (!L->contains(VI))
+        continue;
+    } else {
+      continue;
+    }
+
+    if (!SE.isSCEVable(V->getType()))
+      return false;
+
+    const SCEV *S = SE.getSCEVAtScope(V, L->getParentLoop());
+    if (isa<SCEVCouldNotCompute>(S) || !SE.isLoopInvariant(S, L))
+      return false;
+#if LLVM_VERSION_MAJOR >= 15
+    SCEVExpander Checker(SE, preheader->getModule()->getDataLayout(), "accel");
+    if (!Checker.isSafeToExpandAt(S, insertPt))
+#else
+    if (!isSafeToExpandAt(S, insertPt, SE))
+#endif
+      return false;
+
+    exitValues.emplace_back(PHI, S);
+  }
+
+  SCEVExpander Rewriter(SE, preheader->getModule()->getDataLayout(), "accel");
+  for (auto& it : exitValues) {
+    PHINode *PHI = it.first;
+    Value *V = Rewriter.expandCodeFor(it.second, PHI->getType(), insertPt);
+    PHI->setIncomingValue(PHI->getBasicBlockIndex(exiting), V);
+  }
+
+  // jump from the preheader right to the exit block
+  // (this also fixes the PHI nodes in the exit block)
+  LPM.markLoopAsDeleted(*L);
+  deleteDeadLoop(L, &DT, &SE, &LI);
+
+  llvm::errs() << "Accelerated a loop in " << fname << "\n";
+  return true;
+#else
+  return false;
+#endif
+}
+
+} // namespace
+
+static RegisterPass<AccelerateLoops> AL("accelerate-loops",
+                                        "Replace loops that only compute values "
+                                        "with the closed form of the values");
+char AccelerateLoops::ID;
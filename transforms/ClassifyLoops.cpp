@@ -3,6 +3,8 @@
 // This file is distributed under the University of Illinois Open Source
 // License. See LICENSE.TXT for details.
 
+#include <map>
+#include <set>
 #include <vector>
 
 #include "llvm/IR/DataLayout.h"
@@ -11,27 +13,156 @@
 #include "llvm/IR/Function.h"
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
 #include "llvm/IR/Type.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
 // for checking irreducibility
-#include "llvm/Analysis/LoopIterator.h"
+#include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/Analysis/CFG.h"
 
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/LoopPass.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+
+#include "LoopMetadata.h"
 
 using namespace llvm;
 
+static cl::opt<bool> annotate("classify-loops-annotate",
+        cl::desc("Store the properties of loops as !sbt.loop metadata "
+                 "on the terminators of loop headers"),
+        cl::init(false));
+
+static const char *SBT_LOOP_MD = "sbt.loop";
+
+void setSbtLoopInfo(Loop *L, const SbtLoopInfo& info) {
+  LLVMContext& Ctx = L->getHeader()->getContext();
+  auto *I1 = Type::getInt1Ty(Ctx);
+  auto *I32 = Type::getInt32Ty(Ctx);
+  auto *I64 = Type::getInt64Ty(Ctx);
+
+  std::vector<Metadata *> globals;
+  for (auto *G : info.modifiedGlobals)
+    globals.push_back(ConstantAsMetadata::get(G));
+
+  std::vector<Metadata *> kv;
+  auto add = [&](const char *key, Metadata *val) {
+    kv.push_back(MDString::get(Ctx, key));
+    kv.push_back(val);
+  };
+  auto cnst = [&](Type *Ty, uint64_t val) {
+    return ConstantAsMetadata::get(ConstantInt::get(Ty, val));
+  };
+
+  add("exits", cnst(I32, info.exits));
+  add("trip", cnst(I64, info.tripBound));
+  add("depth", cnst(I32, info.depth));
+  add("irreducible", cnst(I1, info.irreducible));
+  add("pure", cnst(I1, info.pure));
+  add("modifies-unknown", cnst(I1, info.modifiesUnknown));
+  add("modifies-locals", cnst(I32, info.modifiedLocals));
+  add("modifies", MDNode::get(Ctx, globals));
+
+  // a block is the header of at most one loop, but it may be
+  // a latch of several loops (e.g., of an inner and an outer loop),
+  // so the metadata is stored only in the header
+  MDNode *MD = MDNode::get(Ctx, kv);
+  L->getHeader()->getTerminator()->setMetadata(SBT_LOOP_MD, MD);
+}
+
+static bool getInt(const Metadata *MD, uint64_t& val) {
+  auto *C = dyn_cast_or_null<ConstantAsMetadata>(MD);
+  if (!C)
+    return false;
+  auto *CI = dyn_cast<ConstantInt>(C->getValue());
+  if (!CI)
+    return false;
+  val = CI->getZExtValue();
+  return true;
+}
+
+bool getSbtLoopInfo(const Loop *L, SbtLoopInfo& info) {
+  const MDNode *MD = L->getHeader()->getTerminator()->getMetadata(SBT_LOOP_MD);
+
+  if (!MD || MD->getNumOperands() % 2 != 0)
+    return false;
+
+  info = SbtLoopInfo();
+  for (unsigned i = 0; i < MD->getNumOperands(); i += 2) {
+    auto *key = dyn_cast_or_null<MDString>(MD->getOperand(i).get());
+    const Metadata *val = MD->getOperand(i + 1).get();
+    if (!key)
+      return false;
+
+    uint64_t n = 0;
+    const auto& name = key->getString();
+    if (name.equals("modifies")) {
+      auto *globals = dyn_cast_or_null<MDNode>(val);
+      if (!globals)
+        return false;
+      for (auto& Op : globals->operands()) {
+        auto *C = dyn_cast_or_null<ConstantAsMetadata>(Op.get());
+        if (C && isa<GlobalVariable>(C->getValue()))
+          info.modifiedGlobals.push_back(cast<GlobalVariable>(C->getValue()));
+      }
+      continue;
+    }
+
+    if (!getInt(val, n))
+      return false;
+
+    if (name.equals("exits"))
+      info.exits = n;
+    else if (name.equals("trip"))
+      info.tripBound = n;
+    else if (name.equals("depth"))
+      info.depth = n;
+    else if (name.equals("irreducible"))
+      info.irreducible = n;
+    else if (name.equals("pure"))
+      info.pure = n;
+    else if (name.equals("modifies-unknown"))
+      info.modifiesUnknown = n;
+    else if (name.equals("modifies-locals"))
+      info.modifiedLocals = n;
+  }
+
+  return true;
+}
+
 class ClassifyLoops : public LoopPass {
    bool any{false};
    bool nested{false};
    bool nonterm{false};
    bool irreducible{false};
 
+   // the irreducibility is a property of the whole CFG,
+   // so compute it only once for every function
+   std::map<const Function *, bool> irreducibleFuns;
+
+   bool isIrreducible(Function *F) {
+     auto it = irreducibleFuns.find(F);
+     if (it != irreducibleFuns.end())
+       return it->second;
+
+     bool result = false;
+#if LLVM_VERSION_MAJOR > 6
+     LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+     ReversePostOrderTraversal<const Function *> RPOT(F);
+     result = containsIrreducibleCFG<const BasicBlock *>(RPOT, LI);
+#endif
+     irreducibleFuns.emplace(F, result);
+     return result;
+   }
+
+   void classifyMemory(Loop *L, SbtLoopInfo& info);
+
    public:
     static char ID;
 
@@ -40,6 +171,7 @@ class ClassifyLoops : public LoopPass {
     void getAnalysisUsage(AnalysisUsage &AU) const override {
       AU.setPreservesCFG();
       AU.addRequired<LoopInfoWrapperPass>();
+      AU.addRequired<ScalarEvolutionWrapperPass>();
     }
 
     bool runOnLoop(Loop *L, LPPassManager & /*LPM*/) override {
@@ -50,25 +182,29 @@ class ClassifyLoops : public LoopPass {
           nested = true;
       }
 
-      if (!nonterm) {
-        SmallVector<llvm::BasicBlock *, 8> ExitBlocks;
-        L->getExitBlocks(ExitBlocks);
-        if (ExitBlocks.size() == 0) {
-          nonterm = true;
-        }
+      SmallVector<llvm::BasicBlock *, 8> ExitBlocks;
+      L->getExitBlocks(ExitBlocks);
+      if (ExitBlocks.size() == 0) {
+        nonterm = true;
       }
 
-      if (!irreducible) {
-#if LLVM_VERSION_MAJOR > 6
-        // XXX: hmm, not sure this is working...
-        LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
-        LoopBlocksRPO RPOT(L);
-        RPOT.perform(&LI);
-        irreducible = containsIrreducibleCFG<const BasicBlock *>(RPOT, LI);
-#endif
-      }
+      bool irr = isIrreducible(L->getHeader()->getParent());
+      irreducible |= irr;
 
-      return false;
+      if (!annotate)
+        return false;
+
+      SbtLoopInfo info;
+      info.exits = ExitBlocks.size();
+      info.depth = L->getLoopDepth();
+      info.irreducible = irr;
+
+      auto& SE = getAnalysis<ScalarEvolutionWrapperPass>().getSE();
+      info.tripBound = SE.getSmallConstantMaxTripCount(L);
+
+      classifyMemory(L, info);
+      setSbtLoopInfo(L, info);
+      return true;
     }
 
     bool doFinalization() override {
@@ -85,7 +221,54 @@ class ClassifyLoops : public LoopPass {
     }
 };
 
+// Find out what memory the loop may modify
+void ClassifyLoops::classifyMemory(Loop *L, SbtLoopInfo& info) {
+  std::set<const Value *> locals;
+  std::set<GlobalVariable *> globals;
+  // keep the globals in the order of their first write,
+  // so that the metadata do not depend on addresses
+  std::vector<GlobalVariable *> globalsOrder;
+
+  auto addWrite = [&](Value *ptr) {
+    Value *obj = ptr->stripInBoundsOffsets();
+    if (isa<AllocaInst>(obj))
+      locals.insert(obj);
+    else if (auto *G = dyn_cast<GlobalVariable>(obj)) {
+      if (globals.insert(G).second)
+        globalsOrder.push_back(G);
+    }
+    else
+      info.modifiesUnknown = true;
+  };
+
+  for (auto *B : L->blocks()) {
+    for (auto& I : *B) {
+      if (auto *SI = dyn_cast<StoreInst>(&I)) {
+        addWrite(SI->getPointerOperand());
+      } else if (auto *MI = dyn_cast<MemIntrinsic>(&I)) {
+        addWrite(MI->getRawDest());
+      } else if (auto *CI = dyn_cast<CallInst>(&I)) {
+        if (isa<DbgInfoIntrinsic>(CI))
+          continue;
+        if (auto *II = dyn_cast<IntrinsicInst>(CI)) {
+          if (II->getIntrinsicID() == Intrinsic::lifetime_start ||
+              II->getIntrinsicID() == Intrinsic::lifetime_end)
+            continue;
+        }
+        if (CI->mayWriteToMemory())
+          info.modifiesUnknown = true;
+      } else if (I.mayWriteToMemory()) {
+        // atomics
+        info.modifiesUnknown = true;
+      }
+    }
+  }
+
+  info.modifiedLocals = locals.size();
+  info.modifiedGlobals = std::move(globalsOrder);
+  info.pure = !info.modifiesUnknown && globals.empty();
+}
+
 static RegisterPass<ClassifyLoops> CL("classify-loops",
                                       "detect what loops are in the program");
 char ClassifyLoops::ID;
-
@@ -0,0 +1,279 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <cassert>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+static cl::list<std::string> checkFuns("coalesce-checks-fun",
+        cl::desc("Function that checks the validity of memory. It must take "
+                 "a pointer and the number of accessed bytes. "
+                 "Can be given multiple times "
+                 "(default: __INSTR_check_pointer)"));
+
+namespace {
+
+// The check of the bytes [lo, hi) relative to the base pointer
+struct CheckedRange {
+  const Function *fun;
+  const Value *base;
+  int64_t lo;
+  int64_t hi;
+};
+
+// A sequence of checks with the same base pointer that are executed
+// together (there is no instruction in between them that can change
+// the validity of memory). They are all replaced by the first check.
+struct CheckGroup {
+  CallInst *first;
+  int64_t lo;
+  int64_t hi;
+  std::vector<CallInst *> merged;
+};
+
+class CoalesceChecks : public FunctionPass {
+  std::set<std::string> funs;
+  unsigned removed{0};
+  unsigned merged{0};
+
+  const Function *getCheckFun(const CallInst *CI) const;
+  bool isBarrier(const Instruction& I) const;
+  bool getRange(CallInst *CI, const DataLayout& DL, CheckedRange& R) const;
+  bool materialize(CheckGroup& G, const DataLayout& DL);
+
+public:
+  static char ID;
+
+  CoalesceChecks() : FunctionPass(ID) {}
+
+  bool doInitialization(Module& /*M*/) override {
+    funs.insert(checkFuns.begin(), checkFuns.end());
+    if (funs.empty())
+      funs.insert("__INSTR_check_pointer");
+    return false;
+  }
+
+  bool doFinalization(Module& /*M*/) override {
+    if (removed > 0 || merged > 0) {
+      llvm::errs() << "Removed " << removed << " redundant checks and merged "
+                   << merged << " checks\n";
+    }
+    return false;
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+    AU.addRequired<DominatorTreeWrapperPass>();
+  }
+
+  bool runOnFunction(Function &F) override;
+};
+
+const Function *CoalesceChecks::getCheckFun(const CallInst *CI) const {
+#if LLVM_VERSION_MAJOR >= 8
+  auto *F = dyn_cast<Function>(CI->getCalledOperand()->stripPointerCasts());
+#else
+  auto *F = dyn_cast<Function>(CI->getCalledValue()->stripPointerCasts());
+#endif
+  if (!F || funs.count(F->getName().str()) == 0)
+    return nullptr;
+  return F;
+}
+
+// Can the instruction change which memory is valid (or stop the execution)?
+// We are conservative here and take every call except the checks and
+// harmless intrinsics as a barrier.
+bool CoalesceChecks::isBarrier(const Instruction& I) const {
+  auto *CI = dyn_cast<CallInst>(&I);
+  if (!CI)
+    return false;
+  if (isa<DbgInfoIntrinsic>(CI))
+    return false;
+  if (auto *II = dyn_cast<IntrinsicInst>(CI))
+    return II->getIntrinsicID() != Intrinsic::lifetime_start;
+  return getCheckFun(CI) == nullptr;
+}
+
+bool CoalesceChecks::getRange(CallInst *CI, const DataLayout& DL,
+                              CheckedRange& R) const {
+  R.fun = getCheckFun(CI);
+  if (!R.fun || CI->arg_size() != 2)
+    return false;
+
+  Value *ptr = CI->getArgOperand(0);
+  auto *size = dyn_cast<ConstantInt>(CI->getArgOperand(1));
+  if (!ptr->getType()->isPointerTy() || !size || size->isNegative())
+    return false;
+
+  int64_t offset = 0;
+  R.base = GetPointerBaseWithConstantOffset(ptr, offset, DL);
+  R.lo = offset;
+  R.hi = offset + size->getSExtValue();
+  return true;
+}
+
+// Turn the first check of the group into a check of the whole range
+// and remove the rest. The first check keeps its debug location,
+// so that the error is reported at the first access.
+bool CoalesceChecks::materialize(CheckGroup& G, const DataLayout& DL) {
+  if (G.merged.empty())
+    return false;
+
+  CallInst *CI = G.first;
+  Value *ptr = CI->getArgOperand(0);
+  Value *size = CI->getArgOperand(1);
+
+  int64_t offset = 0;
+  Value *base = GetPointerBaseWithConstantOffset(ptr, offset, DL);
+  if (offset != G.lo) {
+    IRBuilder<> IRB(CI);
+    IRB.SetCurrentDebugLocation(CI->getDebugLoc());
+    Value *bytes = IRB.CreatePointerCast(base,
+                                         IRB.getInt8PtrTy(
+                                           base->getType()->getPointerAddressSpace()));
+    if (G.lo != 0)
+      bytes = IRB.CreateGEP(IRB.getInt8Ty(), bytes, IRB.getInt64(G.lo));
+    CI->setArgOperand(0, IRB.CreatePointerCast(bytes, ptr->getType()));
+  }
+  CI->setArgOperand(1, ConstantInt::get(size->getType(), G.hi - G.lo));
+
+  for (auto *M : G.merged) {
+    assert(M->use_empty());
+    M->eraseFromParent();
+    ++merged;
+  }
+
+  return true;
+}
+
+bool CoalesceChecks::runOnFunction(Function &F) {
+  if (F.isDeclaration())
+    return false;
+
+  auto& DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  const DataLayout& DL = F.getParent()->getDataLayout();
+
+  // If there is no barrier in the function, a check is available
+  // in all blocks that it dominates. Otherwise, we follow only
+  // the chains of blocks with a unique predecessor.
+  bool hasBarrier = false;
+  for (auto& B : F) {
+    for (auto& I : B) {
+      if (isBarrier(I)) {
+        hasBarrier = true;
+        break;
+      }
+    }
+  }
+
+  bool changed = false;
+  std::map<const BasicBlock *, std::vector<CheckedRange>> availOut;
+  std::vector<CallInst *> toRemove;
+
+  for (auto *node : depth_first(DT.getRootNode())) {
+    BasicBlock *B = node->getBlock();
+
+    std::vector<CheckedRange> avail;
+    if (auto *idom = node->getIDom()) {
+      const BasicBlock *D = idom->getBlock();
+      if (!hasBarrier || B->getUniquePredecessor() == D)
+        avail = availOut[D];
+    }
+
+    std::map<std::pair<const Function *, const Value *>, CheckGroup> groups;
+    auto flush = [&]() {
+      for (auto& it : groups)
+        changed |= materialize(it.second, DL);
+      groups.clear();
+    };
+
+    for (auto& I : *B) {
+      if (isBarrier(I)) {
+        flush();
+        avail.clear();
+        continue;
+      }
+
+      auto *CI = dyn_cast<CallInst>(&I);
+      if (!CI)
+        continue;
+
+      CheckedRange R;
+      if (!getRange(CI, DL, R))
+        continue;
+
+      bool covered = false;
+      for (auto& A : avail) {
+        if (A.fun == R.fun && A.base == R.base && A.lo <= R.lo && R.hi <= A.hi) {
+          covered = true;
+          break;
+        }
+      }
+
+      if (covered) {
+        toRemove.push_back(CI);
+        continue;
+      }
+
+      auto key = std::make_pair(R.fun, R.base);
+      auto git = groups.find(key);
+      // the new pointer is computed from the base at the place of the first
+      // check, so the base must be available there
+      if (git != groups.end() &&
+          (!isa<Instruction>(R.base) ||
+           DT.dominates(cast<Instruction>(R.base), git->second.first))) {
+        auto& G = git->second;
+        G.lo = std::min(G.lo, R.lo);
+        G.hi = std::max(G.hi, R.hi);
+        G.merged.push_back(CI);
+      } else {
+        if (git != groups.end()) {
+          changed |= materialize(git->second, DL);
+          groups.erase(git);
+        }
+        groups.emplace(key, CheckGroup{CI, R.lo, R.hi, {}});
+      }
+
+      avail.push_back(R);
+    }
+
+    flush();
+    availOut[B] = std::move(avail);
+  }
+
+  for (auto *CI : toRemove) {
+    assert(CI->use_empty());
+    CI->eraseFromParent();
+    ++removed;
+    changed = true;
+  }
+
+  return changed;
+}
+
+} // namespace
+
+static RegisterPass<CoalesceChecks> CCH("coalesce-checks",
+                                        "Remove memory checks covered by dominating "
+                                        "checks and merge checks of the same object");
+char CoalesceChecks::ID;
@@ -8,6 +8,7 @@
 #include <set>
 #include <unordered_map>
 
+#include "llvm/Analysis/DemandedBits.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Constants.h"
@@ -33,6 +34,8 @@
 using namespace llvm;
 
 bool CloneMetadata(const llvm::Instruction *, llvm::Instruction *);
+uint64_t getDemandedBytes(const DataLayout& DL, DemandedBits& DB,
+                          Instruction *I);
 
 class DeleteUndefined : public ModulePass {
   Function *_vms = nullptr; // verifier_make_symbolic function
@@ -46,7 +49,13 @@ class DeleteUndefined : public ModulePass {
   unsigned int calls_count = 0;
 
   //void replaceCall(CallInst *CI, Module *M);
+  // the bytes of the return values of undefined functions
+  // that the callers may observe
+  std::unordered_map<const Function *, uint64_t> demanded_ret_bytes;
+
   void defineFunction(Module *M, Function *F);
+  void computeDemandedRetBytes(Module& M);
+  uint64_t getDemandedRetBytes(Function *F);
 protected:
   DeleteUndefined(char id) : ModulePass(id), _nosym(true) {}
 
@@ -55,6 +64,10 @@ public:
 
   DeleteUndefined() : ModulePass(ID), _nosym(false) {}
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DemandedBitsWrapperPass>();
+  }
+
   virtual bool runOnModule(Module& M) override;
   bool runOnFunction(Function &F);
 };
@@ -208,6 +221,10 @@ bool DeleteUndefined::runOnModule(Module& M) {
     M.materializeAll();
 #endif
 
+    // compute the demanded bytes now, before we start changing the code
+    if (!_nosym)
+      computeDemandedRetBytes(M);
+
     // delete/replace the calls in the rest of functions
     bool modified = false;
     for (auto& F : M.getFunctionList()) {
@@ -290,6 +307,61 @@ Type *DeleteUndefined::get_size_t(llvm::Module *M)
   return _size_t_Ty;
 }
 
+static bool isDefinedAsSymbolic(const Function *F)
+{
+  return F && F->empty() && !F->isIntrinsic() &&
+         !F->getReturnType()->isVoidTy() &&
+         !F->getName().startswith("__VERIFIER_") &&
+         !array_match(F->getName(), leave_calls);
+}
+
+// Find out how many bytes of the return values of the functions
+// that we define the callers may observe. DemandedBits is computed
+// only once for every function with such calls.
+void DeleteUndefined::computeDemandedRetBytes(Module& M)
+{
+  const DataLayout& DL = M.getDataLayout();
+  for (auto& F : M) {
+    if (F.isDeclaration())
+      continue;
+
+    std::vector<CallInst *> calls;
+    for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+      auto *CI = dyn_cast<CallInst>(&*I);
+      if (CI && isDefinedAsSymbolic(CI->getCalledFunction()))
+        calls.push_back(CI);
+    }
+
+    if (calls.empty())
+      continue;
+
+    auto& DB = getAnalysis<DemandedBitsWrapperPass>(F).getDemandedBits();
+    for (auto *CI : calls) {
+      auto& bytes = demanded_ret_bytes[CI->getCalledFunction()];
+      bytes = std::max(bytes, getDemandedBytes(DL, DB, CI));
+    }
+  }
+}
+
+// How many bytes of the return value of F may the callers observe?
+uint64_t DeleteUndefined::getDemandedRetBytes(Function *F)
+{
+  const DataLayout& DL = F->getParent()->getDataLayout();
+  uint64_t size = DL.getTypeAllocSize(F->getReturnType());
+  for (auto *U : F->users()) {
+    auto *CI = dyn_cast<CallInst>(U);
+#if LLVM_VERSION_MAJOR >= 8
+    if (!CI || CI->getCalledOperand() != F)
+#else
+    if (!CI || CI->getCalledValue() != F)
+#endif
+      return size;
+  }
+
+  auto it = demanded_ret_bytes.find(F);
+  return it == demanded_ret_bytes.end() ? 0 : std::min(it->second, size);
+}
+
 void DeleteUndefined::defineFunction(Module *M, Function *F)
 {
   assert(F->size() == 0);
@@ -302,7 +374,17 @@ void DeleteUndefined::defineFunction(Module *M, Function *F)
     // to use the symbolic value
     ReturnInst::Create(Ctx, Constant::getNullValue(F->getReturnType()), block);
   } else {
+    // make symbolic only the bytes that the callers may observe
+    // and zero-extend the value
     Type *Ty = F->getReturnType();
+    uint64_t bytes = getDemandedRetBytes(F);
+    uint64_t size = M->getDataLayout().getTypeAllocSize(Ty);
+    if (bytes < size) {
+      Ty = IntegerType::get(Ctx, std::max<uint64_t>(bytes, 1) * 8);
+      errs() << "Made symbolic " << std::max<uint64_t>(bytes, 1) << " of "
+             << size << " bytes of the result of " << F->getName() << "\n";
+    }
+
     AllocaInst *AI = new AllocaInst(
         Ty,
 #if (LLVM_VERSION_MAJOR >= 5)
@@ -338,7 +420,10 @@ void DeleteUndefined::defineFunction(Module *M, Function *F)
         AI,
         "undefret",
         block);
-    ReturnInst::Create(Ctx, LI, block);
+    Value *ret = LI;
+    if (Ty != F->getReturnType())
+      ret = new ZExtInst(LI, F->getReturnType(), "undefret.zext", block);
+    ReturnInst::Create(Ctx, ret, block);
   }
 
   F->setLinkage(GlobalValue::LinkageTypes::InternalLinkage);
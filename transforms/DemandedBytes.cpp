@@ -0,0 +1,43 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "llvm/ADT/APInt.h"
+#include "llvm/Analysis/DemandedBits.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Type.h"
+#include "llvm/Support/CommandLine.h"
+
+using namespace llvm;
+
+static cl::opt<bool> narrowNondet("narrow-nondet",
+        cl::desc("Make symbolic only the low bytes of nondeterministic "
+                 "integers that the program may observe, the rest is zero "
+                 "(default: true)"),
+        cl::init(true));
+
+/** Get the number of the low bytes of the value of @I that the program
+ * may observe (rounded up to a power of two). The other bytes may
+ * have any value without changing the behavior of the program.
+ *
+ * Note that a comparison observes all the bits, so for instance
+ * the value in 'x < 5' is never narrowed -- that would change the set
+ * of values that x can have.
+ *
+ * @return the number of bytes, at most the alloc size of the type
+ */
+uint64_t getDemandedBytes(const DataLayout& DL, DemandedBits& DB,
+                          Instruction *I) {
+  uint64_t size = DL.getTypeAllocSize(I->getType());
+  if (!narrowNondet || !I->getType()->isIntegerTy())
+    return size;
+
+  unsigned bits = DB.getDemandedBits(I).getActiveBits();
+  uint64_t bytes = 1;
+  while (bytes * 8 < bits)
+    bytes *= 2;
+
+  return std::min(bytes, size);
+}
@@ -0,0 +1,280 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+using namespace llvm;
+
+static cl::opt<unsigned> maxCandidates("devirtualize-calls-max",
+        cl::desc("Do not resolve calls via pointer that may call "
+                 "more functions than this (default: 8)"),
+        cl::init(8));
+
+bool CloneMetadata(const llvm::Instruction *i1, llvm::Instruction *i2);
+
+// Replace calls via pointers with a chain of comparisons of the pointer
+// against the functions that may be called, where each branch calls
+// the function directly:
+//
+//   if (fp == f1) f1(args); else if (fp == f2) f2(args); else fp(args);
+//
+// The functions that may be called are the functions whose address
+// is taken and that have the type of the call. If the pointer is
+// loaded from an internal global that is only ever assigned functions,
+// or if it is a phi/select of functions, we use those functions instead.
+// The last (fallback) branch keeps the original call, so the
+// transformation is sound even if we miss some target. If we know
+// all the targets exactly, the fallback is the call of the last one.
+namespace {
+
+class Devirtualize : public ModulePass {
+  // functions that have their address taken, by type
+  std::map<FunctionType *, std::vector<Function *>> addressTaken;
+
+  bool getTargets(Value *V, std::set<Function *>& targets, bool& exact);
+  bool getGlobalTargets(GlobalVariable *G, std::set<Function *>& targets);
+  void resolveCall(CallInst *CI, const std::vector<Function *>& targets,
+                   bool exact);
+
+public:
+  static char ID;
+
+  Devirtualize() : ModulePass(ID) {}
+
+  bool runOnModule(Module& M) override;
+};
+
+// The functions that are stored to the global (if the global does not
+// escape and is assigned only functions). The null pointer is ignored,
+// calling it is an error anyway.
+bool Devirtualize::getGlobalTargets(GlobalVariable *G,
+                                    std::set<Function *>& targets) {
+  if (!G->hasLocalLinkage() || !G->hasInitializer())
+    return false;
+
+  auto addTarget = [&targets](Value *V) {
+    V = V->stripPointerCasts();
+    if (isa<ConstantPointerNull>(V))
+      return true;
+    if (auto *F = dyn_cast<Function>(V)) {
+      targets.insert(F);
+      return true;
+    }
+    return false;
+  };
+
+  if (!addTarget(G->getInitializer()))
+    return false;
+
+  for (auto *U : G->users()) {
+    if (isa<LoadInst>(U))
+      continue;
+    if (auto *SI = dyn_cast<StoreInst>(U)) {
+      if (SI->getPointerOperand() == G && addTarget(SI->getValueOperand()))
+        continue;
+    }
+    // the address of the global escapes
+    return false;
+  }
+
+  return true;
+}
+
+// Get the functions that the value may point to.
+// Return false if we do not know.
+bool Devirtualize::getTargets(Value *V, std::set<Function *>& targets,
+                              bool& exact) {
+  std::set<Value *> visited;
+  std::vector<Value *> queue = {V};
+  exact = true;
+
+  while (!queue.empty()) {
+    Value *cur = queue.back()->stripPointerCasts();
+    queue.pop_back();
+    if (!visited.insert(cur).second)
+      continue;
+
+    if (auto *F = dyn_cast<Function>(cur)) {
+      targets.insert(F);
+    } else if (auto *PHI = dyn_cast<PHINode>(cur)) {
+      for (auto& In : PHI->incoming_values())
+        queue.push_back(In);
+    } else if (auto *S = dyn_cast<SelectInst>(cur)) {
+      queue.push_back(S->getTrueValue());
+      queue.push_back(S->getFalseValue());
+    } else if (auto *LI = dyn_cast<LoadInst>(cur)) {
+      auto *G = dyn_cast<GlobalVariable>(LI->getPointerOperand()->stripPointerCasts());
+      if (!G || !getGlobalTargets(G, targets))
+        return false;
+      // there may be other stores to the global via pointers
+      // that we did not see (it would be a type confusion, but still)
+      exact = false;
+    } else {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void Devirtualize::resolveCall(CallInst *CI, const std::vector<Function *>& targets,
+                               bool exact) {
+  BasicBlock *B = CI->getParent();
+  Function *F = B->getParent();
+  LLVMContext& Ctx = F->getContext();
+#if LLVM_VERSION_MAJOR >= 8
+  Value *calledValue = CI->getCalledOperand();
+#else
+  Value *calledValue = CI->getCalledValue();
+#endif
+
+  BasicBlock *after = B->splitBasicBlock(CI, "devirt.end");
+  B->getTerminator()->eraseFromParent();
+
+  PHINode *result = nullptr;
+  if (!CI->getType()->isVoidTy()) {
+    result = PHINode::Create(CI->getType(), targets.size() + 1,
+                             CI->getName() + ".devirt", &after->front());
+  }
+
+  std::vector<Value *> args(CI->arg_begin(), CI->arg_end());
+  SmallVector<OperandBundleDef, 2> bundles;
+  CI->getOperandBundlesAsDefs(bundles);
+  BasicBlock *cmpB = B;
+  for (unsigned i = 0; i < targets.size(); ++i) {
+    Function *target = targets[i];
+    // if we know all targets, the last one needs no check
+    bool last = exact && i == targets.size() - 1;
+    BasicBlock *callB = cmpB;
+    if (!last)
+      callB = BasicBlock::Create(Ctx, "devirt." + target->getName(), F, after);
+    auto *direct = CallInst::Create(target, args, bundles, "", callB);
+    direct->setCallingConv(CI->getCallingConv());
+    direct->setAttributes(CI->getAttributes());
+    CloneMetadata(CI, direct);
+    auto *Br = BranchInst::Create(after, callB);
+    CloneMetadata(CI, Br);
+    if (result)
+      result->addIncoming(direct, callB);
+
+    if (last)
+      break;
+
+    BasicBlock *next = BasicBlock::Create(Ctx, "devirt.next", F, after);
+    IRBuilder<> IRB(cmpB);
+    Value *fn = target;
+    if (fn->getType() != calledValue->getType())
+      fn = ConstantExpr::getBitCast(target, calledValue->getType());
+    Value *cmp = IRB.CreateICmpEQ(calledValue, fn);
+    IRB.CreateCondBr(cmp, callB, next);
+    cmpB = next;
+  }
+
+  if (exact) {
+    if (result)
+      CI->replaceAllUsesWith(result);
+    CI->eraseFromParent();
+    return;
+  }
+
+  // the fallback keeps the original indirect call
+  CI->removeFromParent();
+  cmpB->getInstList().push_back(CI);
+  auto *Br = BranchInst::Create(after, cmpB);
+  CloneMetadata(CI, Br);
+  if (result) {
+    CI->replaceAllUsesWith(result);
+    result->addIncoming(CI, cmpB);
+  }
+}
+
+bool Devirtualize::runOnModule(Module& M) {
+  for (auto& F : M) {
+    if (!F.isIntrinsic() && F.hasAddressTaken())
+      addressTaken[F.getFunctionType()].push_back(&F);
+  }
+
+  std::vector<CallInst *> calls;
+  for (auto& F : M) {
+    for (auto& B : F) {
+      for (auto& I : B) {
+        auto *CI = dyn_cast<CallInst>(&I);
+        if (!CI || CI->isInlineAsm() || CI->isMustTailCall())
+          continue;
+#if LLVM_VERSION_MAJOR >= 8
+        Value *calledValue = CI->getCalledOperand();
+#else
+        Value *calledValue = CI->getCalledValue();
+#endif
+        if (!isa<Function>(calledValue->stripPointerCasts()))
+          calls.push_back(CI);
+      }
+    }
+  }
+
+  unsigned resolved = 0;
+  for (auto *CI : calls) {
+#if LLVM_VERSION_MAJOR >= 8
+    Value *calledValue = CI->getCalledOperand();
+#else
+    Value *calledValue = CI->getCalledValue();
+#endif
+    FunctionType *FTy = CI->getFunctionType();
+
+    std::set<Function *> pointsTo;
+    bool exact = false;
+    std::vector<Function *> targets;
+    if (getTargets(calledValue, pointsTo, exact)) {
+      // keep the order of the module, so that the output is deterministic
+      for (auto& F : M) {
+        if (pointsTo.count(&F) == 0)
+          continue;
+        if (F.getFunctionType() == FTy)
+          targets.push_back(&F);
+        else
+          // calling a function of different type is undefined,
+          // but the program may still do it
+          exact = false;
+      }
+    } else {
+      exact = false;
+      auto it = addressTaken.find(FTy);
+      if (it != addressTaken.end())
+        targets = it->second;
+    }
+
+    if (targets.empty() || targets.size() > maxCandidates)
+      continue;
+
+    resolveCall(CI, targets, exact);
+    ++resolved;
+  }
+
+  if (resolved > 0)
+    llvm::errs() << "Resolved " << resolved << " of " << calls.size()
+                 << " calls via pointer\n";
+  return resolved > 0;
+}
+
+} // namespace
+
+static RegisterPass<Devirtualize> DV("devirtualize-calls",
+                                     "Replace calls via pointers with "
+                                     "checks of the pointer and direct calls");
+char Devirtualize::ID;
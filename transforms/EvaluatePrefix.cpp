@@ -0,0 +1,835 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "llvm/ADT/APInt.h"
+#include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+static cl::opt<unsigned> maxSteps("evaluate-main-prefix-max-steps",
+        cl::desc("The maximal number of instructions that are executed "
+                 "when evaluating the prefix of main (default: 1000000)"),
+        cl::init(1000000));
+
+static cl::opt<bool> mallocNeverFails("evaluate-main-prefix-malloc-never-fails",
+        cl::desc("Evaluate also the calls of malloc and calloc in the prefix "
+                 "(they always succeed then, default: false)"),
+        cl::init(false));
+
+// Execute the deterministic prefix of main at compile time and store
+// its effects into the initializers of globals, e.g.,
+//
+//   int table[256];                  int table[256] = {0, 1, 4, ...};
+//   int main(void) {                 int main(void) {
+//     init_table();          -->       int x = __VERIFIER_nondet_int();
+//     int x = __VERIFIER_nondet_int();  ...
+//
+// The prefix are the calls with constant arguments (whose results
+// are not used) and the stores of constants at the beginning of
+// the entry block of main. They are executed one by one by a simple
+// interpreter until the first one that cannot be executed, which is
+// any call of an undefined function (a nondet call, an error call,
+// an instrumentation function, ...), a read of uninitialized memory
+// or of a global without an initializer, any undefined behavior
+// or running out of steps. The calls of malloc and calloc are evaluated
+// only if allocations never fail (-evaluate-main-prefix-malloc-never-fails),
+// the memory that they allocate (and that is not freed) becomes new globals,
+// so the pass must not be used when checking memory safety.
+// The pass must run after -explicit-consdes, so that nothing runs
+// before main.
+namespace {
+
+// The value of a memory object. The aggregates that are written to
+// are expanded into their elements, so that a write changes only
+// one element instead of creating a new constant for the whole
+// object, and the constant is created only once at the end.
+struct MemValue {
+  Type *Ty = nullptr;
+  // the value, or nullptr if the aggregate is expanded
+  Constant *C = nullptr;
+  std::vector<MemValue> elems;
+
+  MemValue() = default;
+  explicit MemValue(Constant *C) : Ty(C->getType()), C(C) {}
+};
+
+class PrefixInterpreter {
+  const DataLayout& DL;
+  Module& M;
+
+  // the values of the local variables of a function
+  using Frame = std::map<const Value *, Constant *>;
+
+  unsigned steps = 0;
+  // the memory objects that are created by the interpreter
+  std::set<GlobalVariable *> allocas, heap;
+
+  Constant *getVal(Frame& frame, Value *V);
+  bool getObject(Constant *ptr, GlobalVariable *&obj, uint64_t& offset);
+  Constant *read(Constant *C, uint64_t off, Type *Ty);
+  Constant *read(const MemValue& MV, uint64_t off, Type *Ty);
+  Constant *writeScalar(Constant *C, uint64_t off, Constant *V);
+  bool write(MemValue& MV, uint64_t off, Constant *V);
+  bool referencesLocals(Constant *C) const;
+  GlobalVariable *createObject(Type *Ty, Constant *init, const char *name);
+  bool memIntrinsic(Frame& frame, IntrinsicInst *II);
+  bool callDeclaration(Frame& frame, CallInst *CI, Constant *&ret);
+  bool execute(Frame& frame, Instruction *I, BasicBlock *&next,
+               Constant *&ret, unsigned depth);
+
+public:
+  // the current values of memory objects
+  std::map<GlobalVariable *, MemValue> memory;
+  // the heap objects that were freed
+  std::set<GlobalVariable *> freed;
+
+  PrefixInterpreter(Module& M) : DL(M.getDataLayout()), M(M) {}
+  ~PrefixInterpreter();
+
+  bool call(Function *F, const std::vector<Constant *>& args,
+            Constant *&ret, unsigned depth = 0);
+  bool store(Constant *ptr, Constant *V);
+  Constant *load(Constant *ptr, Type *Ty);
+  bool referencesLocals(const MemValue& MV) const;
+  static Constant *materialize(const MemValue& MV);
+  bool isHeap(GlobalVariable *GV) const { return heap.count(GV) > 0; }
+};
+
+PrefixInterpreter::~PrefixInterpreter() {
+  // remove the objects that did not become globals
+  // (the local variables and the heap objects from a failed evaluation)
+  std::vector<GlobalVariable *> dead(allocas.begin(), allocas.end());
+  for (auto *GV : heap) {
+    if (memory.count(GV) == 0 && freed.count(GV) == 0)
+      dead.push_back(GV);
+  }
+
+  for (auto *GV : dead) {
+    GV->removeDeadConstantUsers();
+    if (!GV->use_empty())
+      GV->replaceAllUsesWith(Constant::getNullValue(GV->getType()));
+    GV->eraseFromParent();
+  }
+}
+
+GlobalVariable *PrefixInterpreter::createObject(Type *Ty, Constant *init,
+                                                const char *name) {
+  auto *GV = new GlobalVariable(M, Ty, false, GlobalValue::PrivateLinkage,
+                                UndefValue::get(Ty), name);
+  memory[GV] = MemValue(init);
+  return GV;
+}
+
+Constant *PrefixInterpreter::getVal(Frame& frame, Value *V) {
+  if (auto *C = dyn_cast<Constant>(V))
+    return C;
+  auto it = frame.find(V);
+  return it == frame.end() ? nullptr : it->second;
+}
+
+// Get the memory object and the offset in it that the pointer points to
+bool PrefixInterpreter::getObject(Constant *ptr, GlobalVariable *&obj,
+                                  uint64_t& offset) {
+  APInt off(DL.getIndexTypeSizeInBits(ptr->getType()), 0);
+#if LLVM_VERSION_MAJOR >= 10
+  auto *base = ptr->stripAndAccumulateConstantOffsets(DL, off, true);
+#else
+  auto *base = ptr->stripAndAccumulateInBoundsConstantOffsets(DL, off);
+#endif
+  obj = dyn_cast<GlobalVariable>(base);
+  if (!obj || off.isNegative())
+    return false;
+
+  if (memory.count(obj) == 0) {
+    // the objects of the interpreter that are not in memory are dead
+    if (allocas.count(obj) > 0 || heap.count(obj) > 0)
+      return false;
+    if (!obj->hasDefinitiveInitializer() || obj->isExternallyInitialized() ||
+        obj->isThreadLocal())
+      return false;
+    memory[obj] = MemValue(obj->getInitializer());
+  }
+
+  offset = off.getZExtValue();
+  return true;
+}
+
+static bool isByteSizedInt(const Type *Ty) {
+  return Ty->isIntegerTy() && Ty->getIntegerBitWidth() % 8 == 0;
+}
+
+// Find the element of the aggregate type that contains the offset
+static bool getElement(const DataLayout& DL, Type *Ty, uint64_t off,
+                       unsigned& idx, uint64_t& elemOff) {
+  if (auto *STy = dyn_cast<StructType>(Ty)) {
+    const StructLayout *SL = DL.getStructLayout(STy);
+    if (off >= SL->getSizeInBytes())
+      return false;
+    idx = SL->getElementContainingOffset(off);
+    elemOff = off - SL->getElementOffset(idx);
+    return true;
+  }
+
+  if (auto *ATy = dyn_cast<ArrayType>(Ty)) {
+    uint64_t elemSize = DL.getTypeAllocSize(ATy->getElementType());
+    if (elemSize == 0 || off / elemSize >= ATy->getNumElements())
+      return false;
+    idx = off / elemSize;
+    elemOff = off % elemSize;
+    return true;
+  }
+
+  return false;
+}
+
+// Read the value of type Ty from the offset of the constant C
+Constant *PrefixInterpreter::read(Constant *C, uint64_t off, Type *Ty) {
+  Type *CTy = C->getType();
+  if (off == 0 && CTy == Ty)
+    return C;
+
+  uint64_t size = DL.getTypeStoreSize(Ty);
+  if (CTy->isAggregateType()) {
+    unsigned idx;
+    uint64_t elemOff;
+    if (!getElement(DL, CTy, off, idx, elemOff))
+      return nullptr;
+    Constant *E = C->getAggregateElement(idx);
+    if (!E)
+      return nullptr;
+    if (elemOff + size <= DL.getTypeStoreSize(E->getType()))
+      return read(E, elemOff, Ty);
+
+    // an integer composed from several elements (e.g., bytes)
+    if (!isByteSizedInt(Ty))
+      return nullptr;
+    APInt val(Ty->getIntegerBitWidth(), 0);
+    for (uint64_t b = 0; b < size; ++b) {
+      auto *byte = dyn_cast_or_null<ConstantInt>(
+          read(C, off + b, Type::getInt8Ty(M.getContext())));
+      if (!byte)
+        return nullptr;
+      val |= byte->getValue().zext(val.getBitWidth()).shl(8 * b);
+    }
+    return ConstantInt::get(Ty, val);
+  }
+
+  if (isa<UndefValue>(C))
+    return UndefValue::get(Ty);
+
+  // a pointer of a different type
+  if (off == 0 && CTy->isPointerTy() && Ty->isPointerTy())
+    return ConstantExpr::getPointerCast(C, Ty);
+
+  // a part of an integer (the data layout is little endian)
+  auto *CI = dyn_cast<ConstantInt>(C);
+  if (CI && isByteSizedInt(CTy) && isByteSizedInt(Ty) &&
+      DL.isLittleEndian() && off + size <= DL.getTypeStoreSize(CTy))
+    return ConstantInt::get(Ty, CI->getValue().lshr(8 * off)
+                                  .trunc(Ty->getIntegerBitWidth()));
+
+  return nullptr;
+}
+
+// Read the value of type Ty from the offset of the (possibly expanded) value
+Constant *PrefixInterpreter::read(const MemValue& MV, uint64_t off, Type *Ty) {
+  if (MV.C)
+    return read(MV.C, off, Ty);
+  if (off == 0 && MV.Ty == Ty)
+    return materialize(MV);
+
+  unsigned idx;
+  uint64_t elemOff;
+  if (!getElement(DL, MV.Ty, off, idx, elemOff))
+    return nullptr;
+
+  const MemValue& E = MV.elems[idx];
+  uint64_t size = DL.getTypeStoreSize(Ty);
+  if (elemOff + size <= DL.getTypeStoreSize(E.Ty))
+    return read(E, elemOff, Ty);
+
+  // an integer composed from several elements (e.g., bytes)
+  if (!isByteSizedInt(Ty))
+    return nullptr;
+  APInt val(Ty->getIntegerBitWidth(), 0);
+  for (uint64_t b = 0; b < size; ++b) {
+    auto *byte = dyn_cast_or_null<ConstantInt>(
+        read(MV, off + b, Type::getInt8Ty(M.getContext())));
+    if (!byte)
+      return nullptr;
+    val |= byte->getValue().zext(val.getBitWidth()).shl(8 * b);
+  }
+  return ConstantInt::get(Ty, val);
+}
+
+// Write V to the offset of the scalar constant C, return the new constant
+Constant *PrefixInterpreter::writeScalar(Constant *C, uint64_t off,
+                                         Constant *V) {
+  Type *CTy = C->getType();
+  Type *Ty = V->getType();
+  uint64_t size = DL.getTypeStoreSize(Ty);
+
+  // a pointer of a different type
+  if (off == 0 && CTy->isPointerTy() && Ty->isPointerTy())
+    return ConstantExpr::getPointerCast(V, CTy);
+
+  // a part of an integer (the data layout is little endian),
+  // the rest of the integer must be defined
+  auto *CI = dyn_cast<ConstantInt>(C);
+  auto *VI = dyn_cast<ConstantInt>(V);
+  if (CI && VI && isByteSizedInt(CTy) && isByteSizedInt(Ty) &&
+      DL.isLittleEndian() && off + size <= DL.getTypeStoreSize(CTy)) {
+    unsigned bits = CTy->getIntegerBitWidth();
+    APInt mask = APInt::getBitsSet(bits, 8 * off,
+                                   8 * off + Ty->getIntegerBitWidth());
+    APInt val = (CI->getValue() & ~mask) |
+                VI->getValue().zext(bits).shl(8 * off);
+    return ConstantInt::get(CTy, val);
+  }
+
+  return nullptr;
+}
+
+// Write V to the offset of the value, the aggregates on the way
+// are expanded. On failure, a part of the value may be already written.
+bool PrefixInterpreter::write(MemValue& MV, uint64_t off, Constant *V) {
+  Type *Ty = V->getType();
+  if (off == 0 && MV.Ty == Ty) {
+    MV = MemValue(V);
+    return true;
+  }
+
+  if (!MV.Ty->isAggregateType()) {
+    Constant *newC = writeScalar(MV.C, off, V);
+    if (!newC)
+      return false;
+    MV.C = newC;
+    return true;
+  }
+
+  unsigned idx;
+  uint64_t elemOff;
+  if (!getElement(DL, MV.Ty, off, idx, elemOff))
+    return false;
+
+  if (MV.C) {
+    unsigned num = isa<StructType>(MV.Ty) ? MV.Ty->getStructNumElements()
+                                          : MV.Ty->getArrayNumElements();
+    std::vector<MemValue> elems;
+    elems.reserve(num);
+    for (unsigned i = 0; i < num; ++i) {
+      Constant *E = MV.C->getAggregateElement(i);
+      if (!E)
+        return false;
+      elems.emplace_back(E);
+    }
+    MV.elems = std::move(elems);
+    MV.C = nullptr;
+  }
+
+  uint64_t size = DL.getTypeStoreSize(Ty);
+  MemValue& E = MV.elems[idx];
+  if (elemOff + size <= DL.getTypeStoreSize(E.Ty))
+    return write(E, elemOff, V);
+
+  // an integer that spans several elements, write it byte by byte
+  auto *CI = dyn_cast<ConstantInt>(V);
+  if (!CI || !isByteSizedInt(Ty) || !DL.isLittleEndian())
+    return false;
+  for (uint64_t b = 0; b < size; ++b) {
+    APInt byte = CI->getValue().lshr(8 * b).trunc(8);
+    if (!write(MV, off + b, ConstantInt::get(M.getContext(), byte)))
+      return false;
+  }
+  return true;
+}
+
+// Create the constant for the value
+Constant *PrefixInterpreter::materialize(const MemValue& MV) {
+  if (MV.C)
+    return MV.C;
+
+  std::vector<Constant *> elems;
+  elems.reserve(MV.elems.size());
+  for (auto& E : MV.elems)
+    elems.push_back(materialize(E));
+
+  if (auto *STy = dyn_cast<StructType>(MV.Ty))
+    return ConstantStruct::get(STy, elems);
+  return ConstantArray::get(cast<ArrayType>(MV.Ty), elems);
+}
+
+Constant *PrefixInterpreter::load(Constant *ptr, Type *Ty) {
+  GlobalVariable *obj;
+  uint64_t off;
+  if (!getObject(ptr, obj, off))
+    return nullptr;
+  if (off + DL.getTypeStoreSize(Ty) > DL.getTypeAllocSize(obj->getValueType()))
+    return nullptr;
+
+  Constant *V = read(memory[obj], off, Ty);
+  // reading uninitialized memory
+  if (!V || isa<UndefValue>(V))
+    return nullptr;
+  return V;
+}
+
+bool PrefixInterpreter::store(Constant *ptr, Constant *V) {
+  GlobalVariable *obj;
+  uint64_t off;
+  if (!getObject(ptr, obj, off) || obj->isConstant())
+    return false;
+  if (off + DL.getTypeStoreSize(V->getType()) >
+      DL.getTypeAllocSize(obj->getValueType()))
+    return false;
+
+  return write(memory[obj], off, V);
+}
+
+// Does the constant reference a local variable of the interpreted code?
+bool PrefixInterpreter::referencesLocals(Constant *C) const {
+  std::set<const Constant *> visited;
+  std::vector<const Constant *> queue{C};
+  while (!queue.empty()) {
+    const Constant *cur = queue.back();
+    queue.pop_back();
+    if (!visited.insert(cur).second)
+      continue;
+    if (auto *GV = dyn_cast<GlobalVariable>(cur)) {
+      if (allocas.count(const_cast<GlobalVariable *>(GV)) > 0)
+        return true;
+      continue;
+    }
+    for (auto& op : cur->operands())
+      queue.push_back(cast<Constant>(op));
+  }
+
+  return false;
+}
+
+bool PrefixInterpreter::referencesLocals(const MemValue& MV) const {
+  if (MV.C)
+    return referencesLocals(MV.C);
+
+  for (auto& E : MV.elems) {
+    if (referencesLocals(E))
+      return true;
+  }
+  return false;
+}
+
+bool PrefixInterpreter::memIntrinsic(Frame& frame, IntrinsicInst *II) {
+  auto *len = dyn_cast_or_null<ConstantInt>(getVal(frame, II->getArgOperand(2)));
+  Constant *dst = getVal(frame, II->getArgOperand(0));
+  Constant *src = getVal(frame, II->getArgOperand(1));
+  if (!len || !dst || !src)
+    return false;
+
+  Type *I8 = Type::getInt8Ty(M.getContext());
+  Type *I8Ptr = Type::getInt8PtrTy(M.getContext());
+  dst = ConstantExpr::getPointerCast(dst, I8Ptr);
+  bool isSet = II->getIntrinsicID() == Intrinsic::memset;
+  if (isSet) {
+    if (!isa<ConstantInt>(src))
+      return false;
+  } else {
+    src = ConstantExpr::getPointerCast(src, I8Ptr);
+  }
+
+  // copy backwards if the memory may overlap (memmove)
+  uint64_t n = len->getZExtValue();
+  for (uint64_t i = 0; i < n; ++i) {
+    uint64_t b = isSet ? i : n - i - 1;
+    Constant *idx = ConstantInt::get(Type::getInt64Ty(M.getContext()), b);
+    Constant *byte = src;
+    if (!isSet) {
+      byte = load(ConstantExpr::getGetElementPtr(I8, src, idx), I8);
+      if (!byte)
+        return false;
+    }
+    if (!store(ConstantExpr::getGetElementPtr(I8, dst, idx), byte))
+      return false;
+    if (++steps > maxSteps)
+      return false;
+  }
+
+  return true;
+}
+
+// Calls of the functions that the interpreter knows
+bool PrefixInterpreter::callDeclaration(Frame& frame, CallInst *CI,
+                                        Constant *&ret) {
+  const auto& name = CI->getCalledFunction()->getName();
+  // the allocation could fail in the program
+  if ((name.equals("malloc") || name.equals("calloc")) && mallocNeverFails) {
+    uint64_t size = 1;
+    for (auto& arg : CI->args()) {
+      auto *C = dyn_cast_or_null<ConstantInt>(getVal(frame, arg));
+      if (!C)
+        return false;
+      size *= C->getZExtValue();
+    }
+
+    // use the type that the memory is used as, if we know it
+    Type *Ty = ArrayType::get(Type::getInt8Ty(M.getContext()), size);
+    if (CI->hasOneUse()) {
+      if (auto *BC = dyn_cast<BitCastInst>(CI->user_back())) {
+        Type *ETy = BC->getType()->getPointerElementType();
+        if (ETy->isSized() && DL.getTypeAllocSize(ETy) == size)
+          Ty = ETy;
+      }
+    }
+
+    Constant *init = name.equals("calloc") ? Constant::getNullValue(Ty)
+                                           : UndefValue::get(Ty);
+    auto *GV = createObject(Ty, init, "prefix.heap");
+    heap.insert(GV);
+    ret = ConstantExpr::getPointerCast(GV, CI->getType());
+    return true;
+  }
+
+  if (name.equals("free") && CI->arg_size() == 1) {
+    Constant *ptr = getVal(frame, CI->getArgOperand(0));
+    if (!ptr)
+      return false;
+    if (ptr->isNullValue())
+      return true;
+    // only the whole objects from malloc can be freed
+    auto *GV = dyn_cast<GlobalVariable>(ptr->stripPointerCasts());
+    if (!GV || heap.count(GV) == 0 || memory.erase(GV) == 0)
+      return false;
+    freed.insert(GV);
+    return true;
+  }
+
+  return false;
+}
+
+// Execute one instruction, 'next' is set to the next block
+// on the branches and 'ret' to the returned value on returns
+bool PrefixInterpreter::execute(Frame& frame, Instruction *I,
+                                BasicBlock *&next, Constant *&ret,
+                                unsigned depth) {
+  if (++steps > maxSteps)
+    return false;
+
+  if (auto *AI = dyn_cast<AllocaInst>(I)) {
+    Type *Ty = AI->getAllocatedType();
+    if (AI->isArrayAllocation()) {
+      auto *C = dyn_cast_or_null<ConstantInt>(getVal(frame, AI->getArraySize()));
+      if (!C)
+        return false;
+      Ty = ArrayType::get(Ty, C->getZExtValue());
+    }
+    if (!Ty->isSized() || AI->getType()->getAddressSpace() != 0)
+      return false;
+    auto *GV = createObject(Ty, UndefValue::get(Ty), "prefix.alloca");
+    allocas.insert(GV);
+    frame[I] = ConstantExpr::getPointerCast(GV, AI->getType());
+    return true;
+  }
+
+  if (auto *LI = dyn_cast<LoadInst>(I)) {
+    Constant *ptr = getVal(frame, LI->getPointerOperand());
+    if (!LI->isSimple() || !ptr)
+      return false;
+    Constant *V = load(ptr, LI->getType());
+    if (!V)
+      return false;
+    frame[I] = V;
+    return true;
+  }
+
+  if (auto *SI = dyn_cast<StoreInst>(I)) {
+    Constant *ptr = getVal(frame, SI->getPointerOperand());
+    Constant *V = getVal(frame, SI->getValueOperand());
+    return SI->isSimple() && ptr && V && !isa<UndefValue>(V) && store(ptr, V);
+  }
+
+  if (auto *BI = dyn_cast<BranchInst>(I)) {
+    if (BI->isUnconditional()) {
+      next = BI->getSuccessor(0);
+      return true;
+    }
+    auto *C = dyn_cast_or_null<ConstantInt>(getVal(frame, BI->getCondition()));
+    if (!C)
+      return false;
+    next = BI->getSuccessor(C->isZero() ? 1 : 0);
+    return true;
+  }
+
+  if (auto *SI = dyn_cast<SwitchInst>(I)) {
+    auto *C = dyn_cast_or_null<ConstantInt>(getVal(frame, SI->getCondition()));
+    if (!C)
+      return false;
+    next = SI->findCaseValue(C)->getCaseSuccessor();
+    return true;
+  }
+
+  if (auto *RI = dyn_cast<ReturnInst>(I)) {
+    if (Value *V = RI->getReturnValue()) {
+      ret = getVal(frame, V);
+      return ret != nullptr;
+    }
+    return true;
+  }
+
+  if (auto *CI = dyn_cast<CallInst>(I)) {
+    if (auto *II = dyn_cast<IntrinsicInst>(I)) {
+      switch (II->getIntrinsicID()) {
+      case Intrinsic::dbg_declare:
+      case Intrinsic::dbg_value:
+      case Intrinsic::lifetime_start:
+      case Intrinsic::lifetime_end:
+        return true;
+      case Intrinsic::memset:
+      case Intrinsic::memcpy:
+      case Intrinsic::memmove:
+        return memIntrinsic(frame, II);
+      default:
+        return false;
+      }
+    }
+
+    Function *F = CI->getCalledFunction();
+    if (!F || F->isVarArg())
+      return false;
+
+    Constant *val = nullptr;
+    if (F->isDeclaration()) {
+      if (!callDeclaration(frame, CI, val))
+        return false;
+    } else {
+      const auto& fname = F->getName();
+      if (fname.startswith("__VERIFIER_") || fname.startswith("__INSTR_"))
+        return false;
+
+      std::vector<Constant *> args;
+      for (auto& arg : CI->args()) {
+        Constant *C = getVal(frame, arg);
+        if (!C)
+          return false;
+        args.push_back(C);
+      }
+      if (!call(F, args, val, depth + 1))
+        return false;
+    }
+
+    if (!CI->getType()->isVoidTy())
+      frame[I] = val;
+    return true;
+  }
+
+  // arithmetic, comparisons, casts, GEPs, selects, ...
+  if (isa<BinaryOperator>(I) || isa<CmpInst>(I) || isa<CastInst>(I) ||
+      isa<GetElementPtrInst>(I) || isa<SelectInst>(I) ||
+      isa<ExtractValueInst>(I) || isa<InsertValueInst>(I)) {
+    std::vector<Constant *> ops;
+    for (auto& op : I->operands()) {
+      Constant *C = getVal(frame, op);
+      if (!C)
+        return false;
+      ops.push_back(C);
+    }
+    Constant *C = nullptr;
+    if (auto *Cmp = dyn_cast<CmpInst>(I))
+      C = ConstantFoldCompareInstOperands(Cmp->getPredicate(), ops[0], ops[1], DL);
+    else
+      C = ConstantFoldInstOperands(I, ops, DL);
+    // undefined behavior (e.g., division by zero)
+    if (!C || isa<UndefValue>(C))
+      return false;
+    frame[I] = C;
+    return true;
+  }
+
+  return false;
+}
+
+bool PrefixInterpreter::call(Function *F, const std::vector<Constant *>& args,
+                             Constant *&ret, unsigned depth) {
+  if (depth > 64 || F->isDeclaration() || args.size() != F->arg_size())
+    return false;
+
+  Frame frame;
+  unsigned i = 0;
+  for (auto& arg : F->args())
+    frame[&arg] = args[i++];
+
+  // the allocas of this call
+  std::set<GlobalVariable *> prevAllocas = allocas;
+
+  BasicBlock *prev = nullptr;
+  BasicBlock *B = &F->getEntryBlock();
+  bool ok = true;
+  while (ok && B) {
+    // PHI nodes take the values at the same moment
+    std::vector<std::pair<PHINode *, Constant *>> phis;
+    for (auto& phi : B->phis()) {
+      Constant *C = prev ? getVal(frame, phi.getIncomingValueForBlock(prev))
+                         : nullptr;
+      if (!C) {
+        ok = false;
+        break;
+      }
+      phis.emplace_back(&phi, C);
+    }
+    for (auto& it : phis)
+      frame[it.first] = it.second;
+
+    BasicBlock *next = nullptr;
+    for (auto it = B->getFirstNonPHI()->getIterator(), E = B->end();
+         ok && it != E; ++it) {
+      ok = execute(frame, &*it, next, ret, depth);
+    }
+
+    prev = B;
+    B = next;
+  }
+
+  // the local variables die
+  for (auto *GV : allocas) {
+    if (prevAllocas.count(GV) == 0)
+      memory.erase(GV);
+  }
+
+  return ok;
+}
+
+class EvaluatePrefix : public ModulePass {
+  static bool isCandidate(const Instruction *I);
+
+public:
+  static char ID;
+
+  EvaluatePrefix() : ModulePass(ID) {}
+
+  bool runOnModule(Module& M) override;
+};
+
+// Can the instruction be a part of the evaluated prefix?
+bool EvaluatePrefix::isCandidate(const Instruction *I) {
+  if (auto *SI = dyn_cast<StoreInst>(I)) {
+    return SI->isSimple() && isa<Constant>(SI->getValueOperand()) &&
+           isa<Constant>(SI->getPointerOperand());
+  }
+
+  auto *CI = dyn_cast<CallInst>(I);
+  if (!CI || !CI->use_empty() || isa<IntrinsicInst>(CI))
+    return false;
+
+  auto *F = CI->getCalledFunction();
+  if (!F || F->isDeclaration() || F->getName().equals("main"))
+    return false;
+
+  for (auto& arg : CI->args()) {
+    if (!isa<Constant>(arg))
+      return false;
+  }
+
+  return true;
+}
+
+bool EvaluatePrefix::runOnModule(Module& M) {
+  Function *main = M.getFunction("main");
+  if (!main || main->isDeclaration())
+    return false;
+
+  // the constructors would run before the prefix
+  if (auto *ctors = M.getGlobalVariable("llvm.global_ctors")) {
+    if (ctors->hasInitializer() && !ctors->getInitializer()->isNullValue())
+      return false;
+  }
+
+  std::vector<Instruction *> candidates;
+  for (auto& I : main->getEntryBlock()) {
+    // allocas and debugging intrinsics do not change the state
+    if (isa<AllocaInst>(&I) || isa<DbgInfoIntrinsic>(&I))
+      continue;
+    if (!isCandidate(&I))
+      break;
+    candidates.push_back(&I);
+  }
+
+  if (candidates.empty())
+    return false;
+
+  PrefixInterpreter interp(M);
+  size_t len = 0;
+  for (auto *I : candidates) {
+    // the state before this instruction
+    auto memory = interp.memory;
+    auto freed = interp.freed;
+
+    bool ok;
+    if (auto *SI = dyn_cast<StoreInst>(I)) {
+      ok = interp.store(cast<Constant>(SI->getPointerOperand()),
+                        cast<Constant>(SI->getValueOperand()));
+    } else {
+      auto *CI = cast<CallInst>(I);
+      std::vector<Constant *> args;
+      for (auto& arg : CI->args())
+        args.push_back(cast<Constant>(arg));
+      Constant *ret;
+      ok = interp.call(CI->getCalledFunction(), args, ret);
+    }
+
+    // pointers to local variables must not outlive them
+    for (auto it = interp.memory.begin(); ok && it != interp.memory.end(); ++it)
+      ok = !interp.referencesLocals(it->second);
+
+    if (!ok) {
+      interp.memory = std::move(memory);
+      interp.freed = std::move(freed);
+      break;
+    }
+    ++len;
+  }
+
+  if (len == 0)
+    return false;
+
+  for (auto& it : interp.memory)
+    it.first->setInitializer(PrefixInterpreter::materialize(it.second));
+
+  unsigned heapObjects = 0;
+  for (auto& it : interp.memory)
+    heapObjects += interp.isHeap(it.first);
+
+  // the freed objects may be still referenced by dangling pointers
+  for (auto *GV : interp.freed)
+    GV->setInitializer(Constant::getNullValue(GV->getValueType()));
+
+  for (size_t i = 0; i < len; ++i)
+    candidates[i]->eraseFromParent();
+
+  llvm::errs() << "Evaluated " << len << " instructions from the prefix "
+               << "of main (" << heapObjects << " heap objects)\n";
+  return true;
+}
+
+} // namespace
+
+static RegisterPass<EvaluatePrefix> EP("evaluate-main-prefix",
+                                       "Evaluate the deterministic prefix of "
+                                       "main and store its effects into "
+                                       "the initializers of globals");
+char EvaluatePrefix::ID;
@@ -0,0 +1,264 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <vector>
+
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/ConstantRange.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/IR/Type.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+bool CloneMetadata(const llvm::Instruction *i1, llvm::Instruction *i2);
+
+// Fuse the pattern
+//
+//   x = __VERIFIER_nondet_int();
+//   __VERIFIER_assume(x > 0 && x < 10);
+//
+// into
+//
+//   x = (int) __VERIFIER_nondet_range(1, 8);
+//
+// where __VERIFIER_nondet_range(lo, span) returns a value from
+// [lo, lo + span] (lib/verifier/). The verifier then starts with
+// a symbol of the size of the range instead of a full 32-bit symbol
+// that is constrained only later. If the range describes the assumed
+// condition exactly, the assumption is removed, otherwise it is kept.
+// We fuse only assumptions that are in the same block as the nondet
+// call and there is nothing with side-effects between them, so the
+// assumption constrains the value before anybody can observe it.
+namespace {
+
+class FuseNondetAssume : public FunctionPass {
+  Function *_nondet_range = nullptr;
+
+  Function *getNondetRange(Module *M);
+  bool getRange(Value *Cond, const Value *X, ConstantRange& R, bool& exact);
+  bool fuse(CallInst *CI);
+
+public:
+  static char ID;
+
+  FuseNondetAssume() : FunctionPass(ID) {}
+
+  bool runOnFunction(Function &F) override;
+};
+
+static const Function *getCalledFunction(const CallInst *CI) {
+#if LLVM_VERSION_MAJOR >= 8
+  return dyn_cast<Function>(CI->getCalledOperand()->stripPointerCasts());
+#else
+  return dyn_cast<Function>(CI->getCalledValue()->stripPointerCasts());
+#endif
+}
+
+Function *FuseNondetAssume::getNondetRange(Module *M) {
+  if (_nondet_range)
+    return _nondet_range;
+
+  Type *I64 = Type::getInt64Ty(M->getContext());
+  auto C = M->getOrInsertFunction("__VERIFIER_nondet_range",
+                                  I64, I64, I64
+#if LLVM_VERSION_MAJOR < 5
+                                  , nullptr
+#endif
+                                  );
+#if LLVM_VERSION_MAJOR >= 9
+  _nondet_range = cast<Function>(C.getCallee()->stripPointerCasts());
+#else
+  _nondet_range = cast<Function>(C->stripPointerCasts());
+#endif
+  return _nondet_range;
+}
+
+// Get the range of the values of X for which Cond (i1) holds.
+// 'exact' is set to false if the range is only an over-approximation.
+// Return false if Cond is not a condition on X that we understand.
+bool FuseNondetAssume::getRange(Value *Cond, const Value *X,
+                                ConstantRange& R, bool& exact) {
+  if (auto *Cmp = dyn_cast<ICmpInst>(Cond)) {
+    auto pred = Cmp->getPredicate();
+    Value *Op = Cmp->getOperand(0);
+    auto *C = dyn_cast<ConstantInt>(Cmp->getOperand(1));
+    if (!C) {
+      C = dyn_cast<ConstantInt>(Cmp->getOperand(0));
+      Op = Cmp->getOperand(1);
+      pred = Cmp->getSwappedPredicate();
+    }
+    if (!C)
+      return false;
+
+    // instcombine turns 'x > 0 && x < 10' into 'x - 1 <u 9'
+    // (an addend that is not a constant is another constraint)
+    const ConstantInt *Off = nullptr;
+    if (auto *Add = dyn_cast<BinaryOperator>(Op)) {
+      if (Add->getOpcode() == Instruction::Add &&
+          (Off = dyn_cast<ConstantInt>(Add->getOperand(1))))
+        Op = Add->getOperand(0);
+    }
+    if (Op != X)
+      return false;
+
+    // every comparison with a constant is a (possibly wrapped) range
+    R = ConstantRange::makeExactICmpRegion(pred, C->getValue());
+    if (Off)
+      R = R.subtract(Off->getValue());
+    exact = true;
+    return true;
+  }
+
+  // a && b (either 'and', or 'select a, b, false')
+  Value *A = nullptr, *B = nullptr;
+  if (auto *BO = dyn_cast<BinaryOperator>(Cond)) {
+    if (BO->getOpcode() == Instruction::And) {
+      A = BO->getOperand(0);
+      B = BO->getOperand(1);
+    }
+  } else if (auto *Sel = dyn_cast<SelectInst>(Cond)) {
+    auto *F = dyn_cast<ConstantInt>(Sel->getFalseValue());
+    if (F && F->isZero()) {
+      A = Sel->getCondition();
+      B = Sel->getTrueValue();
+    }
+  }
+
+  if (!A || !B)
+    return false;
+
+  unsigned bits = X->getType()->getIntegerBitWidth();
+  ConstantRange RA(bits, true), RB(bits, true);
+  bool exactA, exactB;
+  // a part of the condition that does not talk about X
+  // does not restrict X, but the assumption must stay
+  if (!getRange(A, X, RA, exactA))
+    exactA = false;
+  if (!getRange(B, X, RB, exactB))
+    exactB = false;
+
+  R = RA.intersectWith(RB);
+  // the intersection of two ranges need not be a range
+  ConstantRange under = RA.inverse().unionWith(RB.inverse()).inverse();
+  exact = exactA && exactB && R == under;
+  return true;
+}
+
+bool FuseNondetAssume::fuse(CallInst *CI) {
+  auto *Ty = dyn_cast<IntegerType>(CI->getType());
+  if (!Ty || Ty->getBitWidth() <= 1 || Ty->getBitWidth() > 64)
+    return false;
+
+  // find the assumption
+  CallInst *assume = nullptr;
+  for (auto it = std::next(CI->getIterator()), E = CI->getParent()->end();
+       it != E; ++it) {
+    if (isa<DbgInfoIntrinsic>(&*it))
+      continue;
+    if (auto *C = dyn_cast<CallInst>(&*it)) {
+      auto *F = getCalledFunction(C);
+      if (F && F->getName().equals("__VERIFIER_assume") && C->arg_size() == 1)
+        assume = C;
+      break;
+    }
+    if (it->mayHaveSideEffects() || it->isTerminator())
+      break;
+  }
+
+  if (!assume)
+    return false;
+
+  // __VERIFIER_assume takes int
+  Value *Cond = assume->getArgOperand(0);
+  if (auto *Ext = dyn_cast<ZExtInst>(Cond))
+    Cond = Ext->getOperand(0);
+  else if (auto *Cmp = dyn_cast<ICmpInst>(Cond)) {
+    auto *Zero = dyn_cast<ConstantInt>(Cmp->getOperand(1));
+    if (Cmp->getPredicate() == ICmpInst::ICMP_NE && Zero && Zero->isZero()) {
+      if (auto *Ext = dyn_cast<ZExtInst>(Cmp->getOperand(0)))
+        Cond = Ext->getOperand(0);
+    }
+  }
+
+  if (!Cond->getType()->isIntegerTy(1))
+    return false;
+
+  ConstantRange R(Ty->getBitWidth(), true);
+  bool exact;
+  if (!getRange(Cond, CI, R, exact))
+    return false;
+
+  // nothing to gain, or the assumption can never hold
+  if (R.isFullSet() || R.isEmptySet())
+    return false;
+
+  Module *M = CI->getModule();
+  Type *I64 = Type::getInt64Ty(M->getContext());
+  // the values are lo, lo + 1, ..., lo + span (modulo 2^bits)
+  APInt lo = R.getLower();
+  APInt span = R.getUpper() - R.getLower() - 1;
+  Value *args[] = { ConstantInt::get(I64, lo.getZExtValue()),
+                    ConstantInt::get(I64, span.getZExtValue()) };
+  auto *NewCI = CallInst::Create(getNondetRange(M), args, "", CI);
+  CloneMetadata(CI, NewCI);
+  Value *V = NewCI;
+  if (Ty->getBitWidth() < 64) {
+    auto *Trunc = new TruncInst(NewCI, Ty, "", CI);
+    CloneMetadata(CI, Trunc);
+    V = Trunc;
+  }
+
+  V->takeName(CI);
+  CI->replaceAllUsesWith(V);
+  CI->eraseFromParent();
+  if (exact)
+    assume->eraseFromParent();
+
+  return true;
+}
+
+bool FuseNondetAssume::runOnFunction(Function &F) {
+  const auto& fname = F.getName();
+  if (fname.startswith("__VERIFIER_") || fname.startswith("__INSTR_"))
+    return false;
+
+  std::vector<CallInst *> calls;
+  for (auto& B : F) {
+    for (auto& I : B) {
+      auto *CI = dyn_cast<CallInst>(&I);
+      if (!CI)
+        continue;
+      auto *callee = getCalledFunction(CI);
+      if (callee && callee->isDeclaration() && CI->arg_size() == 0 &&
+          callee->getName().startswith("__VERIFIER_nondet_"))
+        calls.push_back(CI);
+    }
+  }
+
+  unsigned fused = 0;
+  for (auto *CI : calls) {
+    if (fuse(CI))
+      ++fused;
+  }
+
+  if (fused > 0)
+    llvm::errs() << "Fused " << fused << " nondet calls with assumptions in "
+                 << fname << "\n";
+  return fused > 0;
+}
+
+} // namespace
+
+static RegisterPass<FuseNondetAssume> FNA("fuse-nondet-assume",
+                                          "Replace nondet calls followed by "
+                                          "an assumption with a nondet value "
+                                          "from a range");
+char FuseNondetAssume::ID;
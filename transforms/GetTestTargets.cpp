@@ -4,21 +4,53 @@
 // License. See LICENSE.TXT for details.
 
 #include <cassert>
+#include <map>
 #include <set>
 #include <stack>
+#include <vector>
 
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_os_ostream.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
 using namespace llvm;
 
+static cl::opt<bool> Bitmap("get-test-targets-bitmap",
+        cl::desc("Give the targets ids, define the target functions so that "
+                 "they record the hit of the target in the coverage bitmap "
+                 "(__symbiotic_cov_hit). The hits of a path are reported "
+                 "(__symbiotic_cov_flush) only when the path ends. "
+                 "The output then contains also the estimated "
+                 "depth of every target."),
+        cl::init(false));
+
+static cl::opt<bool> Edges("get-test-targets-edges",
+        cl::desc("With -get-test-targets-bitmap, add targets also on "
+                 "the edges of branches (a call on every edge, "
+                 "default: false)"),
+        cl::init(false));
+
+static cl::opt<std::string> Output("get-test-targets-output",
+        cl::desc("Write the targets into this file (default: stdout)"),
+        cl::value_desc("file"), cl::init("-"));
+
 class GetTestTargets : public ModulePass {
+  Function *covHit = nullptr;
+  unsigned n = 0;
+
+  Function *getCovHit(Module& M);
+  void insertTarget(Module& M, Instruction *point, unsigned depth,
+                    raw_ostream& out);
+  void defineCovReport(Module& M);
+  void insertCovFlushes(Module& M);
 public:
   static char ID;
 
@@ -33,21 +65,189 @@ static RegisterPass<GetTestTargets> GTT("get-test-targets",
                                        "Find targets for tests generation");
 char GetTestTargets::ID;
 
+Function *GetTestTargets::getCovHit(Module& M) {
+  if (covHit)
+    return covHit;
+
+  auto& Ctx = M.getContext();
+  //void __symbiotic_cov_hit(unsigned id);
+  auto C = M.getOrInsertFunction("__symbiotic_cov_hit",
+                                 Type::getVoidTy(Ctx),
+                                 Type::getInt32Ty(Ctx)
+#if LLVM_VERSION_MAJOR < 5
+                                 , nullptr
+#endif
+                                 );
+#if LLVM_VERSION_MAJOR >= 9
+  covHit = cast<Function>(C.getCallee());
+#else
+  covHit = cast<Function>(C);
+#endif
+  return covHit;
+}
+
+void GetTestTargets::insertTarget(Module& M, Instruction *point,
+                                  unsigned depth, raw_ostream& out) {
+  auto& Ctx = M.getContext();
+  unsigned id = n++;
+
+  // generate slicing criterion
+  std::string name = "__SYMBIOTIC_test_target" + std::to_string(id);
+  auto funC = M.getOrInsertFunction(name,
+                                    Type::getVoidTy(Ctx)
+#if LLVM_VERSION_MAJOR < 5
+                                    , nullptr
+#endif
+                                    );
+#if LLVM_VERSION_MAJOR >= 9
+  auto *fun = cast<Function>(funC.getCallee());
+#else
+  auto *fun = cast<Function>(funC);
+#endif
+
+  if (Bitmap) {
+    // the target records that it was hit
+    auto *block = BasicBlock::Create(Ctx, "entry", fun);
+    CallInst::Create(getCovHit(M),
+                     {ConstantInt::get(Type::getInt32Ty(Ctx), id)}, "", block);
+    ReturnInst::Create(Ctx, block);
+    fun->setLinkage(GlobalValue::InternalLinkage);
+    fun->addFnAttr(Attribute::NoInline);
+  }
+
+  auto new_CI = CallInst::Create(fun);
+  CloneMetadata(point, new_CI);
+  new_CI->insertBefore(point);
+
+  out << name;
+  if (Bitmap)
+    out << " " << depth;
+  out << "\n";
+}
+
+// Define __symbiotic_cov_report(id) that the runtime calls for every target
+// hit by a path when the path ends. Every target is reported by its own call
+// of __symbiotic_cov_covered(name), so the first path that reports a target
+// covers new code and KLEE writes a test for it even if it outputs only
+// the states that cover new code.
+void GetTestTargets::defineCovReport(Module& M) {
+  auto& Ctx = M.getContext();
+  auto *I32 = Type::getInt32Ty(Ctx);
+  auto coveredC = M.getOrInsertFunction("__symbiotic_cov_covered",
+                                        Type::getVoidTy(Ctx),
+                                        Type::getInt8PtrTy(Ctx)
+#if LLVM_VERSION_MAJOR < 5
+                                        , nullptr
+#endif
+                                        );
+  auto reportC = M.getOrInsertFunction("__symbiotic_cov_report",
+                                       Type::getVoidTy(Ctx), I32
+#if LLVM_VERSION_MAJOR < 5
+                                       , nullptr
+#endif
+                                       );
+#if LLVM_VERSION_MAJOR >= 9
+  auto *report = cast<Function>(reportC.getCallee());
+#else
+  auto *report = cast<Function>(reportC);
+#endif
+  if (!report->isDeclaration())
+    return;
+
+  auto *entry = BasicBlock::Create(Ctx, "entry", report);
+  auto *ret = BasicBlock::Create(Ctx, "ret", report);
+  ReturnInst::Create(Ctx, ret);
+  auto *SI = SwitchInst::Create(&*report->arg_begin(), ret, n, entry);
+  for (unsigned id = 0; id < n; ++id) {
+    auto *block = BasicBlock::Create(Ctx, "target", report);
+    IRBuilder<> IRB(block);
+    IRB.CreateCall(coveredC, {IRB.CreateGlobalStringPtr(
+                                  "__SYMBIOTIC_test_target" + std::to_string(id))});
+    IRB.CreateBr(ret);
+    SI->addCase(ConstantInt::get(I32, id), block);
+  }
+}
+
+// Report the targets hit by the path at the places where the path ends
+// (and KLEE writes a test), i.e., before the return from main and before
+// the calls that terminate the program. The paths that are killed
+// do not report their targets, so the targets remain uncovered.
+void GetTestTargets::insertCovFlushes(Module& M) {
+  auto& Ctx = M.getContext();
+  auto flushC = M.getOrInsertFunction("__symbiotic_cov_flush",
+                                      Type::getVoidTy(Ctx)
+#if LLVM_VERSION_MAJOR < 5
+                                      , nullptr
+#endif
+                                      );
+  static const char *terminating[] = {
+    "exit", "_exit", "_Exit", "abort", "__assert_fail", "reach_error",
+    "__VERIFIER_error", "__VERIFIER_silent_exit"
+  };
+
+  std::vector<Instruction *> points;
+  for (auto& F : M) {
+    if (F.getName().startswith("__symbiotic_cov_") ||
+        F.getName().startswith("__SYMBIOTIC_test_target"))
+      continue;
+    for (auto& B : F) {
+      for (auto& I : B) {
+        if (isa<ReturnInst>(&I) && F.getName().equals("main")) {
+          points.push_back(&I);
+        } else if (auto *CI = dyn_cast<CallInst>(&I)) {
+          auto *callee = CI->getCalledFunction();
+          if (!callee)
+            continue;
+          for (const char *name : terminating) {
+            if (callee->getName().equals(name)) {
+              points.push_back(&I);
+              break;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  for (auto *point : points) {
+    auto *CI = CallInst::Create(flushC);
+    CloneMetadata(point, CI);
+    CI->insertBefore(point);
+  }
+}
+
 bool GetTestTargets::runOnModule(Module& M) {
     bool changed = false;
     std::set<BasicBlock*> visited;
     std::stack<BasicBlock*> queue; // not efficient...
-    auto& Ctx = M.getContext();
-    unsigned n = 0;
+    // the number of blocks on the path that discovered the block,
+    // an estimate of how deep in the program the block is
+    std::map<BasicBlock*, unsigned> depth;
+    std::vector<std::pair<BasicBlock*, BasicBlock*>> edges;
 
     auto *mf = M.getFunction("main");
     if (!mf)
         return false;
+
+    std::error_code EC;
+#if LLVM_VERSION_MAJOR >= 9
+    raw_fd_ostream out(Output, EC, sys::fs::OF_Text);
+#else
+    raw_fd_ostream out(Output, EC, sys::fs::F_Text);
+#endif
+    if (EC) {
+        llvm::errs() << "ERROR: cannot open '" << Output << "': "
+                     << EC.message() << "\n";
+        return false;
+    }
+
     queue.push(&mf->getEntryBlock());
+    depth[&mf->getEntryBlock()] = 0;
 
     while (!queue.empty()) {
         auto *cur = queue.top();
         queue.pop();
+        unsigned curDepth = depth[cur];
 
         bool has_call = false;
         for (auto& I : *cur) {
@@ -56,42 +256,48 @@ bool GetTestTargets::runOnModule(Module& M) {
               if (!F->isDeclaration()) {
                 has_call = true;
                 auto *entry = &F->getEntryBlock();
-                if (visited.insert(entry).second)
+                if (visited.insert(entry).second) {
+                  depth[entry] = curDepth + 1;
                   queue.push(entry);
+                }
               }
             }
           }
         }
 
         if ((succ_begin(cur) == succ_end(cur)) && !has_call) {
-          // generate slicing criterion
-          std::string name = "__SYMBIOTIC_test_target" + std::to_string(n++);
-          auto funC = M.getOrInsertFunction(name,
-                                            Type::getVoidTy(Ctx)
-#if LLVM_VERSION_MAJOR < 5
-                                            , nullptr
-#endif
-                                            );
-#if LLVM_VERSION_MAJOR >= 9
-          auto *fun = cast<Function>(funC.getCallee());
-#else
-          auto *fun = cast<Function>(funC);
-#endif
-          auto new_CI = CallInst::Create(fun);
-          auto *point = cur->getFirstNonPHI();
-          CloneMetadata(point, new_CI);
-          new_CI->insertBefore(point);
-
+          insertTarget(M, cur->getFirstNonPHI(), curDepth, out);
           changed = true;
-          llvm::outs() << name << "\n";
         } else {
+          auto *T = cur->getTerminator();
+          bool branches = isa<SwitchInst>(T) ||
+                          (isa<BranchInst>(T) && cast<BranchInst>(T)->isConditional());
+          std::set<BasicBlock*> succs;
           for (auto *succ : successors(cur)) {
-            if (visited.insert(succ).second)
+            if (Bitmap && Edges && branches && succs.insert(succ).second)
+              edges.emplace_back(cur, succ);
+            if (visited.insert(succ).second) {
+              depth[succ] = curDepth + 1;
               queue.push(succ);
+            }
           }
         }
     }
 
+    // the targets on the edges of branches (they change the CFG,
+    // so we add them after the traversal)
+    for (auto& edge : edges) {
+        BasicBlock *succ = edge.second;
+        if (!succ->getSinglePredecessor())
+          succ = SplitEdge(edge.first, edge.second);
+        insertTarget(M, &*succ->getFirstInsertionPt(), depth[edge.first] + 1, out);
+        changed = true;
+    }
+
+    if (Bitmap && n > 0) {
+        defineCovReport(M);
+        insertCovFlushes(M);
+    }
 
   return changed;
 }
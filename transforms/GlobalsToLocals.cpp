@@ -0,0 +1,284 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/IR/Type.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+// Turn global variables that are used only in a single function
+// that is executed at most once into local variables of the function,
+// e.g.,
+//
+//   int g = 5;                       int main(void) {
+//   int main(void) {          -->      int g = 5;
+//     g += nondet(); ...               g += nondet(); ...
+//
+// The new alloca is initialized from the initializer of the global
+// at the beginning of the function, so mem2reg and SROA can then
+// promote the variable to registers and the slicer and the verifier
+// do not need to track it as a memory object.
+//
+// A function is executed at most once if it is main and nobody calls it,
+// or if it has only one call site that is not on a cycle in the CFG and
+// the caller is executed at most once (which in practice are functions
+// called from main that are not inlined). The address of the global
+// must not escape, because the local variable dies when the function
+// returns. Globals that may hold pointers are kept, since a pointer
+// to a heap object stored only in a global is not a leak, but it is
+// a leak once the global becomes a local variable that dies (e.g.,
+// when main calls exit). The pass must run on the whole program (i.e., after linking
+// the runtime), because it removes the globals that it promotes.
+namespace {
+
+class GlobalsToLocals : public ModulePass {
+  // cache for isExecutedOnce
+  std::map<const Function *, bool> _executed_once;
+
+  bool isExecutedOnce(const Function *F, std::set<const Function *>& visited);
+  bool checkUses(const Value *V, const Function *&F);
+  bool promote(GlobalVariable *GV, Function *F);
+
+public:
+  static char ID;
+
+  GlobalsToLocals() : ModulePass(ID) {}
+
+  bool runOnModule(Module& M) override;
+};
+
+// Is the block on a cycle in the CFG?
+static bool isOnCycle(const BasicBlock *B) {
+  std::set<const BasicBlock *> visited;
+  std::vector<const BasicBlock *> queue(succ_begin(B), succ_end(B));
+  while (!queue.empty()) {
+    const BasicBlock *cur = queue.back();
+    queue.pop_back();
+    if (cur == B)
+      return true;
+    if (!visited.insert(cur).second)
+      continue;
+    for (const BasicBlock *succ : successors(cur))
+      queue.push_back(succ);
+  }
+
+  return false;
+}
+
+static bool containsPointer(const Type *Ty) {
+  if (Ty->isPointerTy())
+    return true;
+  if (auto *STy = dyn_cast<StructType>(Ty)) {
+    for (const Type *ETy : STy->elements()) {
+      if (containsPointer(ETy))
+        return true;
+    }
+    return false;
+  }
+  if (auto *ATy = dyn_cast<ArrayType>(Ty))
+    return containsPointer(ATy->getElementType());
+  if (auto *VTy = dyn_cast<VectorType>(Ty))
+    return containsPointer(VTy->getElementType());
+
+  return false;
+}
+
+bool GlobalsToLocals::isExecutedOnce(const Function *F,
+                                     std::set<const Function *>& visited) {
+  auto it = _executed_once.find(F);
+  if (it != _executed_once.end())
+    return it->second;
+
+  bool ret = false;
+  if (F->getName().equals("main")) {
+    ret = F->use_empty();
+  } else if (F->hasLocalLinkage() && F->hasOneUse() &&
+             visited.insert(F).second) {
+    // the only use must be a direct call (not, e.g., taking the address)
+    auto *CI = dyn_cast<CallInst>(F->user_back());
+#if LLVM_VERSION_MAJOR >= 8
+    if (CI && CI->getCalledOperand() == F &&
+#else
+    if (CI && CI->getCalledValue() == F &&
+#endif
+        !isOnCycle(CI->getParent()))
+      ret = isExecutedOnce(CI->getParent()->getParent(), visited);
+  }
+
+  _executed_once[F] = ret;
+  return ret;
+}
+
+// Check that all the uses of V are instructions from a single function
+// (stored to F) that only access the memory pointed to by V, i.e.,
+// that V does not escape.
+bool GlobalsToLocals::checkUses(const Value *V, const Function *&F) {
+  for (auto *U : V->users()) {
+    if (auto *CE = dyn_cast<ConstantExpr>(U)) {
+      if (CE->getOpcode() != Instruction::BitCast &&
+          CE->getOpcode() != Instruction::GetElementPtr)
+        return false;
+      if (!checkUses(CE, F))
+        return false;
+      continue;
+    }
+
+    auto *I = dyn_cast<Instruction>(U);
+    if (!I)
+      return false;
+    if (F && I->getParent()->getParent() != F)
+      return false;
+    F = I->getParent()->getParent();
+
+    if (isa<LoadInst>(I) || isa<ICmpInst>(I) ||
+        isa<DbgInfoIntrinsic>(I) || isa<MemIntrinsic>(I))
+      continue;
+    if (auto *SI = dyn_cast<StoreInst>(I)) {
+      if (SI->getValueOperand() == V)
+        return false;
+      continue;
+    }
+    if (auto *II = dyn_cast<IntrinsicInst>(I)) {
+      if (II->getIntrinsicID() == Intrinsic::lifetime_start ||
+          II->getIntrinsicID() == Intrinsic::lifetime_end)
+        continue;
+      return false;
+    }
+    if (isa<GetElementPtrInst>(I) || isa<BitCastInst>(I)) {
+      if (!checkUses(I, F))
+        return false;
+      continue;
+    }
+
+    return false;
+  }
+
+  return true;
+}
+
+// Turn the constant expressions that use C into instructions
+// (at every place where they are used), so that all users of C
+// are instructions.
+static void expandConstantExprUses(Constant *C) {
+  std::vector<User *> users(C->user_begin(), C->user_end());
+  for (auto *U : users) {
+    auto *CE = dyn_cast<ConstantExpr>(U);
+    if (!CE)
+      continue;
+
+    expandConstantExprUses(CE);
+
+    std::vector<User *> ceusers(CE->user_begin(), CE->user_end());
+    for (auto *CU : ceusers) {
+      auto *I = cast<Instruction>(CU);
+      // a PHI node may have the same incoming block several times,
+      // the values must be the same then
+      std::map<BasicBlock *, Instruction *> phiValues;
+      for (unsigned i = 0, e = I->getNumOperands(); i < e; ++i) {
+        if (I->getOperand(i) != CE)
+          continue;
+
+        Instruction *NewI = nullptr;
+        if (auto *PHI = dyn_cast<PHINode>(I)) {
+          // the instruction must be at the end of the incoming block
+          BasicBlock *B = PHI->getIncomingBlock(i);
+          auto& V = phiValues[B];
+          if (!V) {
+            V = CE->getAsInstruction();
+            V->insertBefore(B->getTerminator());
+          }
+          NewI = V;
+        } else {
+          NewI = CE->getAsInstruction();
+          NewI->insertBefore(I);
+        }
+        I->setOperand(i, NewI);
+      }
+    }
+    CE->destroyConstant();
+  }
+}
+
+bool GlobalsToLocals::promote(GlobalVariable *GV, Function *F) {
+  Module *M = F->getParent();
+  const DataLayout& DL = M->getDataLayout();
+  Type *Ty = GV->getValueType();
+  Instruction *entry = &*F->getEntryBlock().getFirstInsertionPt();
+
+#if LLVM_VERSION_MAJOR >= 11
+  auto *AI = new AllocaInst(Ty, DL.getAllocaAddrSpace(), nullptr,
+                            DL.getPreferredAlign(GV), GV->getName(), entry);
+#elif LLVM_VERSION_MAJOR >= 5
+  auto *AI = new AllocaInst(Ty, DL.getAllocaAddrSpace(), nullptr,
+                            DL.getPreferredAlignment(GV), GV->getName(), entry);
+#else
+  auto *AI = new AllocaInst(Ty, nullptr, DL.getPreferredAlignment(GV),
+                            GV->getName(), entry);
+#endif
+  new StoreInst(GV->getInitializer(), AI, entry);
+
+  Value *New = AI;
+  if (AI->getType() != GV->getType())
+    New = CastInst::CreatePointerCast(AI, GV->getType(), "", entry);
+
+  expandConstantExprUses(GV);
+  GV->replaceAllUsesWith(New);
+  GV->eraseFromParent();
+  return true;
+}
+
+bool GlobalsToLocals::runOnModule(Module& M) {
+  std::vector<std::pair<GlobalVariable *, Function *>> toPromote;
+  for (GlobalVariable& GV : M.globals()) {
+    if (GV.isDeclaration() || GV.isConstant() || GV.isThreadLocal() ||
+        GV.isExternallyInitialized() || GV.getName().startswith("llvm.") ||
+        containsPointer(GV.getValueType()))
+      continue;
+
+    const Function *F = nullptr;
+    if (!checkUses(&GV, F) || !F)
+      continue;
+
+    const auto& fname = F->getName();
+    if (fname.startswith("__VERIFIER_") || fname.startswith("__INSTR_"))
+      continue;
+
+    std::set<const Function *> visited;
+    if (!isExecutedOnce(F, visited))
+      continue;
+
+    toPromote.emplace_back(&GV, const_cast<Function *>(F));
+  }
+
+  for (auto& it : toPromote) {
+    llvm::errs() << "Promoting global " << it.first->getName()
+                 << " to a local variable of " << it.second->getName() << "\n";
+    promote(it.first, it.second);
+  }
+
+  return !toPromote.empty();
+}
+
+} // namespace
+
+static RegisterPass<GlobalsToLocals> GTL("globals-to-locals",
+                                         "Turn globals used only in a function "
+                                         "that runs at most once into locals");
+char GlobalsToLocals::ID;
@@ -0,0 +1,295 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <vector>
+
+#include "llvm/Analysis/CFG.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/IR/Type.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+static cl::opt<uint64_t> maxSize("heap-to-stack-max-size",
+        cl::desc("Promote only allocations of at most this many bytes "
+                 "(default: 4096)"),
+        cl::init(4096));
+
+static cl::opt<bool> neverFails("heap-to-stack-never-fails",
+        cl::desc("Assume that the promoted allocations never fail "
+                 "(otherwise they non-deterministically return NULL)"),
+        cl::init(false));
+
+bool CloneMetadata(const llvm::Instruction *i1, llvm::Instruction *i2);
+
+// Replace malloc/calloc of constant size with an alloca if the memory
+// does not escape the function and it is freed in the function exactly
+// once on every path and not used after it is freed. Such allocations
+// cannot lead to memory-safety errors that would disappear by the
+// transformation, so the verifier does not need to track them as heap
+// objects. The pass must run before the instrumentation (its calls are
+// escapes) and after -mem2reg (stores to stack slots are escapes too).
+namespace {
+
+class HeapToStack : public FunctionPass {
+  Function *nondetBool = nullptr;
+
+  bool collectUses(Value *V, const CallInst *alloc,
+                   std::vector<Instruction *>& uses,
+                   std::vector<CallInst *>& frees);
+  bool canPromote(CallInst *CI, uint64_t size, CallInst *&freeCall);
+  void promote(CallInst *CI, uint64_t size, bool zeroed, CallInst *freeCall);
+  Function *getNondetBool(Module *M);
+
+public:
+  static char ID;
+
+  HeapToStack() : FunctionPass(ID) {}
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<PostDominatorTreeWrapperPass>();
+    AU.addRequired<LoopInfoWrapperPass>();
+  }
+
+  bool runOnFunction(Function &F) override;
+};
+
+static const Function *getCalledFunction(const CallInst *CI) {
+#if LLVM_VERSION_MAJOR >= 8
+  return dyn_cast<Function>(CI->getCalledOperand()->stripPointerCasts());
+#else
+  return dyn_cast<Function>(CI->getCalledValue()->stripPointerCasts());
+#endif
+}
+
+// Collect the (transitive) uses of the allocated memory.
+// Return false if the memory may escape.
+bool HeapToStack::collectUses(Value *V, const CallInst *alloc,
+                              std::vector<Instruction *>& uses,
+                              std::vector<CallInst *>& frees) {
+  for (auto *U : V->users()) {
+    auto *I = dyn_cast<Instruction>(U);
+    if (!I)
+      return false;
+
+    if (isa<BitCastInst>(I) || isa<GetElementPtrInst>(I)) {
+      uses.push_back(I);
+      if (!collectUses(I, alloc, uses, frees))
+        return false;
+    } else if (isa<LoadInst>(I) || isa<ICmpInst>(I)) {
+      uses.push_back(I);
+    } else if (auto *SI = dyn_cast<StoreInst>(I)) {
+      // storing the pointer somewhere makes it escape
+      if (SI->getValueOperand() == V)
+        return false;
+      uses.push_back(I);
+    } else if (isa<MemIntrinsic>(I) || isa<DbgInfoIntrinsic>(I)) {
+      uses.push_back(I);
+    } else if (auto *CI = dyn_cast<CallInst>(I)) {
+      auto *callee = getCalledFunction(CI);
+      if (!callee || !callee->getName().equals("free") ||
+          CI->arg_size() != 1)
+        return false;
+      // freeing a pointer into the object is an error
+      // that we do not want to hide
+      if (CI->getArgOperand(0)->stripPointerCasts() != alloc)
+        return false;
+      frees.push_back(CI);
+    } else {
+      // phi, select, ptrtoint, return, ...
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool HeapToStack::canPromote(CallInst *CI, uint64_t size, CallInst *&freeCall) {
+  if (size == 0 || size > maxSize)
+    return false;
+
+  auto& LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  auto& DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  auto& PDT = getAnalysis<PostDominatorTreeWrapperPass>().getPostDomTree();
+
+  // in a loop, every iteration would get the same memory
+  if (LI.getLoopFor(CI->getParent()))
+    return false;
+
+  std::vector<Instruction *> uses;
+  std::vector<CallInst *> frees;
+  if (!collectUses(CI, CI, uses, frees))
+    return false;
+
+  // the memory must be freed exactly once on every path,
+  // otherwise the program has a leak or a double free
+  if (frees.size() != 1)
+    return false;
+
+  freeCall = frees[0];
+  if (LI.getLoopFor(freeCall->getParent()))
+    return false;
+  if (freeCall->getParent() == CI->getParent()) {
+    // the free must come after the allocation
+    auto it = CI->getIterator();
+    while (it != CI->getParent()->end() && &*it != freeCall)
+      ++it;
+    if (it == CI->getParent()->end())
+      return false;
+  } else if (!PDT.dominates(freeCall->getParent(), CI->getParent())) {
+    return false;
+  }
+
+  // no use after free
+  for (auto *I : uses) {
+    if (isPotentiallyReachable(freeCall, I, nullptr, &DT, &LI))
+      return false;
+  }
+
+  return true;
+}
+
+Function *HeapToStack::getNondetBool(Module *M) {
+  if (nondetBool)
+    return nondetBool;
+
+  auto C = M->getOrInsertFunction("__VERIFIER_nondet_bool",
+                                  Type::getInt1Ty(M->getContext())
+#if LLVM_VERSION_MAJOR < 5
+                                  , nullptr
+#endif
+                                  );
+#if LLVM_VERSION_MAJOR >= 9
+  nondetBool = cast<Function>(C.getCallee()->stripPointerCasts());
+#else
+  nondetBool = cast<Function>(C->stripPointerCasts());
+#endif
+  return nondetBool;
+}
+
+void HeapToStack::promote(CallInst *CI, uint64_t size, bool zeroed,
+                          CallInst *freeCall) {
+  Function *F = CI->getParent()->getParent();
+  Module *M = F->getParent();
+  LLVMContext& Ctx = M->getContext();
+
+  Type *Ty = ArrayType::get(Type::getInt8Ty(Ctx), size);
+  Instruction *entry = &*F->getEntryBlock().getFirstInsertionPt();
+#if LLVM_VERSION_MAJOR >= 11
+  auto *AI = new AllocaInst(Ty, M->getDataLayout().getAllocaAddrSpace(),
+                            nullptr, Align(16), "h2s", entry);
+#elif LLVM_VERSION_MAJOR >= 5
+  auto *AI = new AllocaInst(Ty, M->getDataLayout().getAllocaAddrSpace(),
+                            nullptr, 16, "h2s", entry);
+#else
+  auto *AI = new AllocaInst(Ty, nullptr, 16, "h2s", entry);
+#endif
+  CloneMetadata(CI, AI);
+
+  // calloc'd memory is zeroed where the original call was
+  if (zeroed) {
+    auto *SI = new StoreInst(Constant::getNullValue(Ty), AI, CI);
+    CloneMetadata(CI, SI);
+  }
+
+  Value *mem = AI;
+  if (mem->getType() != CI->getType()) {
+    auto *Cast = CastInst::CreatePointerCast(AI, CI->getType(), "", CI);
+    CloneMetadata(CI, Cast);
+    mem = Cast;
+  }
+
+  if (!neverFails) {
+    Instruction *fails = CallInst::Create(getNondetBool(M), "", CI);
+    CloneMetadata(CI, fails);
+    // the program may have declared the function with a different type
+    if (!fails->getType()->isIntegerTy(1)) {
+      fails = new ICmpInst(CI, ICmpInst::ICMP_NE, fails,
+                           Constant::getNullValue(fails->getType()));
+      CloneMetadata(CI, fails);
+    }
+    auto *Sel = SelectInst::Create(fails,
+                                   ConstantPointerNull::get(cast<PointerType>(CI->getType())),
+                                   mem, "", CI);
+    CloneMetadata(CI, Sel);
+    mem = Sel;
+  }
+
+  CI->replaceAllUsesWith(mem);
+  CI->eraseFromParent();
+  // the memory is released when the function returns
+  freeCall->eraseFromParent();
+}
+
+bool HeapToStack::runOnFunction(Function &F) {
+  const auto& fname = F.getName();
+  if (fname.startswith("__VERIFIER_") || fname.startswith("__INSTR_"))
+    return false;
+
+  std::vector<CallInst *> allocs;
+  for (auto& B : F) {
+    for (auto& I : B) {
+      auto *CI = dyn_cast<CallInst>(&I);
+      if (!CI)
+        continue;
+      auto *callee = getCalledFunction(CI);
+      if (!callee || !callee->isDeclaration())
+        continue;
+      if ((callee->getName().equals("malloc") && CI->arg_size() == 1) ||
+          (callee->getName().equals("calloc") && CI->arg_size() == 2))
+        allocs.push_back(CI);
+    }
+  }
+
+  unsigned promoted = 0;
+  for (auto *CI : allocs) {
+    if (!CI->getType()->isPointerTy())
+      continue;
+
+    uint64_t size = 1;
+    bool constant = true;
+    for (unsigned i = 0, e = CI->arg_size(); i < e; ++i) {
+      auto *C = dyn_cast<ConstantInt>(CI->getArgOperand(i));
+      if (!C || C->getValue().getActiveBits() > 32) {
+        constant = false;
+        break;
+      }
+      size *= C->getZExtValue();
+    }
+
+    CallInst *freeCall = nullptr;
+    if (!constant || !canPromote(CI, size, freeCall))
+      continue;
+
+    bool zeroed = CI->arg_size() == 2;
+    promote(CI, size, zeroed, freeCall);
+    ++promoted;
+  }
+
+  if (promoted > 0)
+    llvm::errs() << "Promoted " << promoted << " heap allocations to stack in "
+                 << fname << "\n";
+  return promoted > 0;
+}
+
+} // namespace
+
+static RegisterPass<HeapToStack> H2S("heap-to-stack",
+                                     "Replace malloc/calloc of constant size "
+                                     "whose memory does not escape and is freed "
+                                     "in the same function with alloca");
+char HeapToStack::ID;
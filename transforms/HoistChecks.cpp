@@ -0,0 +1,138 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <vector>
+
+#include "llvm/Analysis/LoopPass.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+
+using namespace llvm;
+
+// Move the checks (assertions and assumptions) whose conditions
+// are loop-invariant from the loop to the preheader of the loop, e.g.,
+//
+//   do {                             __VERIFIER_assert(n > 0);
+//     __VERIFIER_assert(n > 0); -->  do {
+//     ...                              ...
+//   } while (i < n);                 } while (i < n);
+//
+// The checks must be at the beginning of the header, so the loop
+// must execute its body at least once (a while loop is handled after
+// -loop-rotate turns it into a guarded do-while loop, the check
+// then goes after the guard).
+// A check with invariant arguments has the same result in every
+// iteration, so it is enough to evaluate it once before the loop.
+// We hoist only the checks that are executed in every iteration
+// before anything that could change what happens (a side-effect,
+// a possible error, a branch), i.e., the checks that are in the
+// straight-line code at the beginning of the loop with only
+// speculatable instructions before them. Then the check in the preheader
+// is executed exactly when the original check would be executed
+// in the first iteration and there is nothing observable between them.
+// The debug location of a check is kept, so the errors are reported
+// at the original place.
+//
+// Only the checks whose result depends solely on their arguments
+// are hoisted, the instrumentation checks that look into the state
+// of the memory (e.g., __INSTR_check_pointer) are not.
+namespace {
+
+class HoistChecks : public LoopPass {
+  static bool isCheck(const CallInst *CI);
+
+public:
+  static char ID;
+
+  HoistChecks() : LoopPass(ID) {}
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    getLoopAnalysisUsage(AU);
+  }
+
+  bool runOnLoop(Loop *L, LPPassManager &LPM) override;
+};
+
+bool HoistChecks::isCheck(const CallInst *CI) {
+  const Function *F = CI->getCalledFunction();
+  if (!F)
+    return false;
+
+  const auto& name = F->getName();
+  return name.equals("__VERIFIER_assert") ||
+         name.equals("__VERIFIER_assert_or_assume") ||
+         name.equals("__VERIFIER_assume") ||
+         name.equals("__INSTR_check_assume");
+}
+
+bool HoistChecks::runOnLoop(Loop *L, LPPassManager & /*LPM*/) {
+  BasicBlock *preheader = L->getLoopPreheader();
+  if (!preheader)
+    return false;
+
+  Instruction *insertPt = preheader->getTerminator();
+  unsigned hoisted = 0;
+  BasicBlock *B = L->getHeader();
+  while (B) {
+    BasicBlock *next = nullptr;
+    for (auto it = B->getFirstNonPHI()->getIterator(), E = B->end();
+         it != E;) {
+      Instruction *I = &*it++;
+      if (isa<DbgInfoIntrinsic>(I))
+        continue;
+
+      if (auto *CI = dyn_cast<CallInst>(I)) {
+        if (!isCheck(CI))
+          break;
+
+        // try moving the computation of the arguments out of the loop
+        bool invariant = true;
+        for (auto& arg : CI->args()) {
+          bool changed = false;
+          invariant &= L->makeLoopInvariant(arg, changed, insertPt);
+        }
+        if (!invariant)
+          break;
+
+        CI->moveBefore(insertPt);
+        ++hoisted;
+        continue;
+      }
+
+      // straight-line code continues in the next block
+      if (auto *BI = dyn_cast<BranchInst>(I)) {
+        BasicBlock *succ = BI->isUnconditional() ? BI->getSuccessor(0) : nullptr;
+        if (succ && succ != L->getHeader() && L->contains(succ) &&
+            succ->getSinglePredecessor() == B)
+          next = succ;
+        break;
+      }
+
+      // nothing observable can happen before the checks
+      if (!isSafeToSpeculativelyExecute(I))
+        break;
+    }
+
+    B = next;
+  }
+
+  if (hoisted > 0)
+    llvm::errs() << "Hoisted " << hoisted << " checks from a loop in "
+                 << preheader->getParent()->getName() << "\n";
+  return hoisted > 0;
+}
+
+} // namespace
+
+static RegisterPass<HoistChecks> HC("hoist-checks",
+                                    "Hoist checks with loop-invariant "
+                                    "conditions out of loops");
+char HoistChecks::ID;
@@ -0,0 +1,262 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <vector>
+
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+using namespace llvm;
+
+static cl::opt<unsigned> maxArmSize("if-convert-max-insts",
+        cl::desc("Flatten only branches whose arms have together at most "
+                 "this many instructions (default: 16)"),
+        cl::init(16));
+
+bool CloneMetadata(const llvm::Instruction *i1, llvm::Instruction *i2);
+
+// Flatten the branches whose arms only compute values, i.e.
+//
+//   B: br c, T, F        B: ...T..., ...F...
+//   T: ...; br J   -->      %x = select c, %t, %f
+//   F: ...; br J            br J
+//   J: %x = phi [%t, T], [%f, F]
+//
+// (and similarly for the triangles where F = J). A symbolic executor
+// forks on every branch with a symbolic condition, but not on selects,
+// so this merges the states already in the program. Unlike -simplifycfg,
+// we speculate also longer arms and calls of functions that are speculatable
+// (by the attribute or because their body is), because
+// the cost of a fork is much higher than the cost of a few instructions.
+// Arms that may fail (loads of invalid pointers, divisions by zero,
+// calls to error functions, ...)
+// are never speculated, so every error stays on its own path.
+namespace {
+
+class IfConvert : public FunctionPass {
+  static bool hasSpeculatableBody(const Function& F);
+  static bool canSpeculate(const Instruction& I);
+  static bool isSpeculatableArm(BasicBlock *B, BasicBlock *pred,
+                                BasicBlock *succ, unsigned& size);
+  bool convert(BasicBlock *B);
+
+public:
+  static char ID;
+
+  IfConvert() : FunctionPass(ID) {}
+
+  bool runOnFunction(Function &F) override;
+};
+
+// Is the body of F a single block whose instructions can all be
+// executed unconditionally? Then a call of F cannot fail and always
+// returns. A function that is pure and returns may still be undefined
+// for some arguments (e.g., if it divides by its argument),
+// so the attributes of F are not enough.
+bool IfConvert::hasSpeculatableBody(const Function& F) {
+  if (F.isDeclaration() || !F.hasExactDefinition() || F.size() != 1)
+    return false;
+
+  const BasicBlock& B = F.getEntryBlock();
+  if (!isa<ReturnInst>(B.getTerminator()))
+    return false;
+
+  for (auto& I : B) {
+    if (&I == B.getTerminator())
+      break;
+    if (isa<DbgInfoIntrinsic>(&I))
+      continue;
+    if (!isSafeToSpeculativelyExecute(&I))
+      return false;
+  }
+
+  return true;
+}
+
+bool IfConvert::canSpeculate(const Instruction& I) {
+  if (isa<DbgInfoIntrinsic>(&I))
+    return true;
+
+  if (auto *CI = dyn_cast<CallInst>(&I)) {
+#if LLVM_VERSION_MAJOR >= 8
+    auto *F = dyn_cast<Function>(CI->getCalledOperand()->stripPointerCasts());
+#else
+    auto *F = dyn_cast<Function>(CI->getCalledValue()->stripPointerCasts());
+#endif
+    if (!F || F->isIntrinsic())
+      return isSafeToSpeculativelyExecute(&I);
+
+    const auto& name = F->getName();
+    if (name.startswith("__VERIFIER_") || name.startswith("__INSTR_") ||
+        name.startswith("__symbiotic"))
+      return false;
+
+#if LLVM_VERSION_MAJOR >= 5
+    if (F->hasFnAttribute(Attribute::Speculatable))
+      return true;
+#endif
+    return hasSpeculatableBody(*F);
+  }
+
+  return isSafeToSpeculativelyExecute(&I);
+}
+
+// Can we move the instructions of B (that has the single predecessor pred
+// and the single successor succ) to pred?
+bool IfConvert::isSpeculatableArm(BasicBlock *B, BasicBlock *pred,
+                                  BasicBlock *succ, unsigned& size) {
+  if (B->getSinglePredecessor() != pred)
+    return false;
+
+  auto *Br = dyn_cast<BranchInst>(B->getTerminator());
+  if (!Br || Br->isConditional() || Br->getSuccessor(0) != succ)
+    return false;
+
+  for (auto& I : *B) {
+    if (&I == Br)
+      break;
+    if (isa<PHINode>(&I) || !canSpeculate(I))
+      return false;
+    if (!isa<DbgInfoIntrinsic>(&I))
+      ++size;
+  }
+
+  return size <= maxArmSize;
+}
+
+bool IfConvert::convert(BasicBlock *B) {
+  auto *Br = dyn_cast<BranchInst>(B->getTerminator());
+  if (!Br || !Br->isConditional() || isa<Constant>(Br->getCondition()))
+    return false;
+
+  BasicBlock *T = Br->getSuccessor(0);
+  BasicBlock *F = Br->getSuccessor(1);
+  if (T == F || T == B || F == B)
+    return false;
+
+  // the arms that we flatten (one of them may be empty)
+  BasicBlock *join = nullptr;
+  BasicBlock *armT = nullptr, *armF = nullptr;
+  unsigned size = 0;
+  if (T->getSingleSuccessor() && T->getSingleSuccessor() == F->getSingleSuccessor()) {
+    // diamond
+    join = T->getSingleSuccessor();
+    armT = T;
+    armF = F;
+  } else if (T->getSingleSuccessor() == F) {
+    // triangle with the true arm
+    join = F;
+    armT = T;
+  } else if (F->getSingleSuccessor() == T) {
+    // triangle with the false arm
+    join = T;
+    armF = F;
+  } else {
+    return false;
+  }
+
+  if (join == B)
+    return false;
+  if (armT && !isSpeculatableArm(armT, B, join, size))
+    return false;
+  if (armF && !isSpeculatableArm(armF, B, join, size))
+    return false;
+
+  // hoist the instructions of the arms
+  for (BasicBlock *arm : {armT, armF}) {
+    if (!arm)
+      continue;
+    while (&arm->front() != arm->getTerminator())
+      arm->front().moveBefore(Br);
+  }
+
+  // the values coming from the arms (or from B in a triangle)
+  // become selects
+  BasicBlock *fromT = armT ? armT : B;
+  BasicBlock *fromF = armF ? armF : B;
+  for (auto& I : *join) {
+    auto *PHI = dyn_cast<PHINode>(&I);
+    if (!PHI)
+      break;
+
+    Value *vT = PHI->getIncomingValueForBlock(fromT);
+    Value *vF = PHI->getIncomingValueForBlock(fromF);
+    Value *V = vT;
+    if (vT != vF) {
+      auto *Sel = SelectInst::Create(Br->getCondition(), vT, vF,
+                                     PHI->getName() + ".ifc", Br);
+      CloneMetadata(Br, Sel);
+      V = Sel;
+    }
+
+    if (armT)
+      PHI->removeIncomingValue(armT, false);
+    if (armF)
+      PHI->removeIncomingValue(armF, false);
+    if (armT && armF)
+      PHI->addIncoming(V, B);
+    else
+      PHI->setIncomingValue(PHI->getBasicBlockIndex(B), V);
+  }
+
+  auto *NewBr = BranchInst::Create(join, Br);
+  CloneMetadata(Br, NewBr);
+  Br->eraseFromParent();
+
+  for (BasicBlock *arm : {armT, armF}) {
+    if (arm)
+      arm->eraseFromParent();
+  }
+
+  return true;
+}
+
+bool IfConvert::runOnFunction(Function &F) {
+  const auto& fname = F.getName();
+  if (fname.startswith("__VERIFIER_") || fname.startswith("__INSTR_"))
+    return false;
+
+  // visit the blocks in post-order, so that the inner branches are
+  // flattened before the branches that enclose them. The arms and
+  // the merged joins are erased, their handles become null then.
+  std::vector<WeakVH> blocks;
+  for (BasicBlock *B : post_order(&F))
+    blocks.emplace_back(B);
+
+  unsigned converted = 0;
+  for (auto& VH : blocks) {
+    auto *B = cast_or_null<BasicBlock>(static_cast<Value *>(VH));
+    while (B && convert(B)) {
+      ++converted;
+      // merge the join block to B if B is its only predecessor,
+      // then the branch of the join is the next candidate
+      // and B can become an arm of the enclosing branch
+      MergeBlockIntoPredecessor(B->getSingleSuccessor());
+    }
+  }
+
+  if (converted > 0)
+    llvm::errs() << "Flattened " << converted << " branches in "
+                 << fname << "\n";
+  return converted > 0;
+}
+
+} // namespace
+
+static RegisterPass<IfConvert> IFC("if-convert",
+                                   "Replace branches whose arms only compute "
+                                   "values with selects");
+char IfConvert::ID;
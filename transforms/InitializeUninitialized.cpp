@@ -25,6 +25,8 @@
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include <llvm/IR/DebugInfoMetadata.h>
 
+#include "SplitNondet.h"
+
 using namespace llvm;
 
 bool CloneMetadata(const llvm::Instruction *, llvm::Instruction *);
@@ -38,6 +40,8 @@ class InitializeUninitialized : public ModulePass {
 
     Function *get_verifier_make_nondet(Module *);
     Type *get_size_t(Module *);
+    Instruction *makeNondetFields(AllocaInst *AI, Value *mem,
+                                  const std::string& name, Instruction *pos);
   public:
     static char ID;
 
@@ -176,6 +180,63 @@ GlobalVariable *getNameGlobal(Module *M, const std::string& name)
   return G;
 }
 
+// Make every scalar field of the memory 'mem' (of the type allocated
+// by AI) a separate nondeterministic object. KLEE can make symbolic
+// only whole objects, so every field gets a new object that is made
+// nondeterministic and copied into the field. The code is inserted
+// after 'pos'. Returns the last inserted instruction or nullptr
+// if the memory should not be split.
+Instruction *InitializeUninitialized::makeNondetFields(AllocaInst *AI,
+                                                       Value *mem,
+                                                       const std::string& name,
+                                                       Instruction *pos)
+{
+  std::vector<NondetField> fields;
+  if (!getNondetFields(*DL, AI->getAllocatedType(), fields))
+    return nullptr;
+
+  Module *M = AI->getModule();
+  LLVMContext& Ctx = M->getContext();
+  Function *C = get_verifier_make_nondet(M);
+  Instruction *insertPt = pos->getNextNode();
+
+  CastInst *CastI = CastInst::CreatePointerCast(mem, Type::getInt8PtrTy(Ctx),
+                                                "", insertPt);
+  CloneMetadata(AI, CastI);
+
+  for (auto& field : fields) {
+    Instruction *addr = CastI;
+    if (field.offset > 0) {
+      Value *off = ConstantInt::get(get_size_t(M), field.offset);
+      addr = GetElementPtrInst::CreateInBounds(Type::getInt8Ty(Ctx), CastI, off,
+                                               "", insertPt);
+      CloneMetadata(AI, addr);
+    }
+
+    AllocaInst *obj = createFieldObject(*DL, field.size, insertPt);
+    CloneMetadata(AI, obj);
+    CastInst *objCast = CastInst::CreatePointerCast(obj, Type::getInt8PtrTy(Ctx),
+                                                    "", insertPt);
+    CloneMetadata(AI, objCast);
+
+    // name the object after the field, e.g., main:uninitialized.1[2]:0
+    GlobalVariable *nameG = getNameGlobal(M, name + field.suffix + ":0");
+    std::vector<Value *> args;
+    args.push_back(objCast);
+    args.push_back(ConstantInt::get(get_size_t(M), field.size));
+    args.push_back(ConstantExpr::getPointerCast(nameG, Type::getInt8PtrTy(Ctx)));
+    args.push_back(ConstantInt::get(Type::getInt32Ty(Ctx), ++calls_count));
+
+    CallInst *CI = CallInst::Create(C, args, "", insertPt);
+    CloneMetadata(AI, CI);
+    CloneMetadata(AI, createFieldCopy(addr, objCast, field.size, insertPt));
+  }
+
+  llvm::errs() << "Split the symbolic object " << name << " into "
+               << fields.size() << " fields\n";
+  return insertPt->getPrevNode();
+}
+
 bool InitializeUninitialized::runOnFunction(Function &F)
 {
   // do not run the initializer on __VERIFIER and __INSTR functions
@@ -208,6 +269,14 @@ bool InitializeUninitialized::runOnFunction(Function &F)
       // to the original alloca. This way slicer will slice this
       // initialization away if program initialize it manually later
       if (Ty->isSized()) {
+        // small arrays and structs may be made symbolic field by field
+        // (every field through its own object)
+        if (Ty->isAggregateType() && !AI->isArrayAllocation() &&
+            makeNondetFields(AI, AI, F.getName().str() + ":uninitialized", AI)) {
+            modified = true;
+            continue;
+        }
+
         GlobalVariable *name = getNameGlobal(M, F.getName().str() + ":uninitialized:0");
         Function *C = get_verifier_make_nondet(M);
         // if this is an array allocation, just call verifier_make_nondet on it,
@@ -12,6 +12,7 @@
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
@@ -21,6 +22,8 @@
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/IR/DebugInfoMetadata.h"
 
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/Analysis/CallGraph.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/LoopPass.h"
 
@@ -28,17 +31,63 @@ llvm::cl::opt<bool> insertHeader("instrument-nontermination-mark-header",
         llvm::cl::desc("Insert a function that marks the header of the loop"),
         llvm::cl::init(false));
 
+llvm::cl::opt<unsigned> snapshotMin("instrument-nontermination-snapshot",
+        llvm::cl::desc("Keep the state of loops that use at least N variables "
+                       "in one buffer that is compared by a single check "
+                       "(0 = never, default)"),
+        llvm::cl::init(0));
+
+llvm::cl::opt<unsigned> snapshotMax("instrument-nontermination-snapshot-max",
+        llvm::cl::desc("Maximal number of variables in the snapshot buffer, "
+                       "loops with more variables are instrumented with "
+                       "comparisons of single variables (default 256)"),
+        llvm::cl::init(256));
+
 using namespace llvm;
 
 bool CloneMetadata(const llvm::Instruction *, llvm::Instruction *);
 
+namespace {
+
+// What a function (together with all the functions that it calls)
+// does with the memory
+struct FunctionSummary {
+  // global variables that the function reads or writes
+  std::set<llvm::Value *> globals;
+  // the function accesses memory that is not a global variable
+  // or its own local variable (or we do not know what it accesses)
+  bool nonLocalMemory{false};
+  // the function calls a function via a pointer
+  bool indirectCalls{false};
+  // the function is (mutually) recursive or calls a recursive function
+  bool recursive{false};
+
+  bool isAnalyzable() const {
+    return !nonLocalMemory && !indirectCalls && !recursive;
+  }
+
+  void join(const FunctionSummary& rhs) {
+    globals.insert(rhs.globals.begin(), rhs.globals.end());
+    nonLocalMemory |= rhs.nonLocalMemory;
+    indirectCalls |= rhs.indirectCalls;
+    recursive |= rhs.recursive;
+  }
+};
+
+} // namespace
+
 class InstrumentNontermination : public LoopPass {
-  bool checkInstruction(Instruction& I, std::set<llvm::Value *>& variables,
-                        std::vector<llvm::Function *> callstack);
-  bool checkFunction(Function *F, std::set<llvm::Value *>& variables,
-                     std::vector<llvm::Function *> callstack);
+  // summaries of functions, computed once for the whole module
+  std::map<const llvm::Function *, FunctionSummary> summaries;
+  const llvm::Module *summarizedModule{nullptr};
+
+  void computeSummaries(Module& M);
+  void summarizeInstruction(Instruction& I, FunctionSummary& S,
+                            const std::set<llvm::Function *>& scc);
+  bool checkInstruction(Instruction& I, std::set<llvm::Value *>& variables);
   bool instrumentLoop(Loop *L);
   bool instrumentLoop(Loop *L, const std::set<llvm::Value *>& variables);
+  bool instrumentLoopSnapshot(Loop *L, const std::set<llvm::Value *>& variables);
   bool instrumentEmptyLoop(Loop *L);
 
   bool checkOperand(llvm::Value *v,
@@ -94,45 +143,84 @@ class InstrumentNontermination : public LoopPass {
           return false;
       }
 
+      // the instrumentation does not change the summaries
+      // (it adds only accesses to locals and known globals
+      // and calls to undefined functions), so we can compute
+      // them only once
+      Module *M = L->getHeader()->getModule();
+      if (summarizedModule != M) {
+        computeSummaries(*M);
+        summarizedModule = M;
+      }
+
       return instrumentLoop(L);
     }
 };
 
-bool InstrumentNontermination::checkFunction(Function *F,
-                                             std::set<llvm::Value *>& usedValues,
-                                             std::vector<llvm::Function *> callstack) {
-  if (!F) // call via pointer
-      return false;
+// functions that we know that do not touch the memory
+static bool isHarmlessFunction(const Function *F) {
+  return F->getName().equals("__VERIFIER_assume") ||
+         F->getName().equals("__VERIFIER_assert") ||
+         F->getName().startswith("__VERIFIER_nondet_") ||
+         F->getName().startswith("__VERIFIER_exit") ||
+         F->getName().startswith("__VERIFIER_silent_exit") ||
+         F->getName().startswith("exit") ||
+         F->getName().startswith("_exit") ||
+         F->getName().startswith("abort") ||
+         F->getName().startswith("klee_silent_exit") ||
+         F->getName().startswith("llvm.dbg.");
+}
 
-  if (F->getName().equals("__VERIFIER_assume") ||
-      F->getName().equals("__VERIFIER_assert") ||
-      F->getName().startswith("__VERIFIER_nondet_") ||
-      F->getName().startswith("__VERIFIER_exit") ||
-      F->getName().startswith("__VERIFIER_silent_exit") ||
-      F->getName().startswith("exit") ||
-      F->getName().startswith("_exit") ||
-      F->getName().startswith("abort") ||
-      F->getName().startswith("klee_silent_exit") ||
-      F->getName().startswith("llvm.dbg."))
-    return true;
-
-  for (auto *onstack : callstack) {
-      if (onstack == F) {
-          return false; // recursion
-      }
+void InstrumentNontermination::summarizeInstruction(Instruction& I,
+                                                    FunctionSummary& S,
+                                                    const std::set<llvm::Function *>& scc) {
+  if (auto *CI = dyn_cast<CallInst>(&I)) {
+    auto *callee = CI->getCalledFunction();
+    if (!callee) {
+      S.indirectCalls = true;
+    } else if (!isHarmlessFunction(callee) && scc.count(callee) == 0) {
+      // the callee is in an SCC below us, so it has been already summarized
+      // (undefined functions have an empty summary)
+      auto it = summaries.find(callee);
+      if (it != summaries.end())
+        S.join(it->second);
+    }
+  } else if (auto LI = dyn_cast<LoadInst>(&I)) {
+    if (!checkOperand(LI->getPointerOperand(), S.globals, true))
+      S.nonLocalMemory = true;
+  } else if (auto SI = dyn_cast<StoreInst>(&I)) {
+    if (!checkOperand(SI->getPointerOperand(), S.globals, true))
+      S.nonLocalMemory = true;
+  } else if (I.mayReadOrWriteMemory()) {
+    S.nonLocalMemory = true;
   }
+}
 
-  callstack.push_back(F);
+// Compute the summaries bottom-up in the call graph. All functions
+// in one SCC share the summary.
+void InstrumentNontermination::computeSummaries(Module& M) {
+  summaries.clear();
+
+  CallGraph CG(M);
+  for (auto I = scc_begin(&CG); !I.isAtEnd(); ++I) {
+    std::set<llvm::Function *> scc;
+    for (auto *node : *I) {
+      if (auto *F = node->getFunction())
+        scc.insert(F);
+    }
 
-  for (auto& B : *F) {
-    for (auto& I : B) {
-      if (!checkInstruction(I, usedValues, callstack)) {
-        return false;
+    FunctionSummary S;
+    S.recursive = I.hasCycle();
+    for (auto *F : scc) {
+      for (auto& B : *F) {
+        for (auto& Inst : B)
+          summarizeInstruction(Inst, S, scc);
       }
     }
-  }
 
-  return true;
+    for (auto *F : scc)
+      summaries[F] = S;
+  }
 }
 
 bool InstrumentNontermination::instrumentLoop(Loop *L) {
@@ -142,9 +230,7 @@ bool InstrumentNontermination::instrumentLoop(Loop *L) {
     // check that the loop reads and writes only to known
     // locations (allocas and global variables)
     for (auto& I : *block) {
-      // hmm... could be implemented more efficiently,
-      // but it should be quite fast even though.
-      if (!checkInstruction(I, usedValues, {})) {
+      if (!checkInstruction(I, usedValues)) {
         return false;
       }
     }
@@ -155,21 +241,26 @@ bool InstrumentNontermination::instrumentLoop(Loop *L) {
 }
 
 bool InstrumentNontermination::checkInstruction(Instruction& I,
-                                                std::set<llvm::Value*>& usedValues,
-                                                std::vector<llvm::Function *> callstack) {
-  bool isNested = !callstack.empty();
-  //llvm::errs() << "checking (" << isNested << "): " << I << "\n";
-
+                                                std::set<llvm::Value*>& usedValues) {
   if (auto *CI = dyn_cast<CallInst>(&I)) {
-    if (!checkFunction(CI->getCalledFunction(), usedValues, callstack)) {
+    auto *callee = CI->getCalledFunction();
+    if (!callee) // call via pointer
       return false;
-    }
+    if (isHarmlessFunction(callee))
+      return true;
+
+    auto it = summaries.find(callee);
+    if (it == summaries.end()) // undefined function
+      return true;
+    if (!it->second.isAnalyzable())
+      return false;
+    usedValues.insert(it->second.globals.begin(), it->second.globals.end());
   } else if (auto LI = dyn_cast<LoadInst>(&I)) {
-    if (!checkOperand(LI->getPointerOperand(), usedValues, isNested)) {
+    if (!checkOperand(LI->getPointerOperand(), usedValues, false)) {
       return false;
     }
   } else if (auto SI = dyn_cast<StoreInst>(&I)) {
-    if (!checkOperand(SI->getPointerOperand(), usedValues, isNested)) {
+    if (!checkOperand(SI->getPointerOperand(), usedValues, false)) {
       return false;
     }
   } else {
@@ -188,6 +279,11 @@ bool InstrumentNontermination::instrumentLoop(Loop *L, const std::set<llvm::Valu
   assert(header);
   auto *M = header->getModule();
 
+  if (snapshotMin > 0 && variables.size() >= snapshotMin &&
+      variables.size() <= snapshotMax) {
+    return instrumentLoopSnapshot(L, variables);
+  }
+
   // mapping of old to new ones
   std::map<Value *, Value *> mapping;
 
@@ -350,6 +446,117 @@ bool InstrumentNontermination::instrumentLoop(Loop *L, const std::set<llvm::Valu
   return true;
 }
 
+static void createMemCpy(IRBuilder<>& IRB, Value *dst, Value *src, uint64_t size) {
+#if LLVM_VERSION_MAJOR >= 10
+  IRB.CreateMemCpy(dst, MaybeAlign(1), src, MaybeAlign(1), size);
+#elif LLVM_VERSION_MAJOR >= 7
+  IRB.CreateMemCpy(dst, 1, src, 1, size);
+#else
+  IRB.CreateMemCpy(dst, src, size, 1);
+#endif
+}
+
+// Instead of comparing every variable with its copy, copy all the variables
+// into one buffer and compare the whole buffer with the snapshot of the state
+// from the previous iteration by one call of __INSTR_check_nontermination_mem.
+// The snapshot is taken when entering the loop and then it is just updated
+// by one memcpy on every back edge (the state at the back edge is the state
+// at the beginning of the next iteration).
+bool InstrumentNontermination::instrumentLoopSnapshot(Loop *L,
+                                                      const std::set<llvm::Value *>& variables) {
+  auto *header = L->getHeader();
+  auto *F = header->getParent();
+  auto *M = F->getParent();
+  auto& Ctx = M->getContext();
+  const DataLayout& DL = M->getDataLayout();
+
+  // offsets of the variables in the buffer
+  std::vector<std::pair<Value *, uint64_t>> layout;
+  uint64_t size = 0;
+  for (auto *v : variables) {
+    Type *Ty = v->getType()->getPointerElementType();
+    if (!Ty->isSized()) {
+      llvm::errs() << "ERROR: Unhandled copying: " << *v << "\n";
+      return false;
+    }
+    layout.emplace_back(v, size);
+    size += DL.getTypeAllocSize(Ty);
+  }
+
+  auto *I8PtrTy = Type::getInt8PtrTy(Ctx);
+  auto *SizeTy = DL.getIntPtrType(Ctx);
+  auto *BufTy = ArrayType::get(Type::getInt8Ty(Ctx), size);
+  auto *entryTerm = F->getBasicBlockList().front().getTerminator();
+  auto *snapshot = new AllocaInst(BufTy,
+#if (LLVM_VERSION_MAJOR >= 5)
+                                  DL.getAllocaAddrSpace(),
+#endif
+                                  nullptr, "nonterm.snapshot", entryTerm);
+  auto *state = new AllocaInst(BufTy,
+#if (LLVM_VERSION_MAJOR >= 5)
+                               DL.getAllocaAddrSpace(),
+#endif
+                               nullptr, "nonterm.state", entryTerm);
+
+  auto copyState = [&](IRBuilder<>& IRB, Value *buf) {
+    for (auto& it : layout) {
+      Type *Ty = it.first->getType()->getPointerElementType();
+      Value *dst = IRB.CreateConstInBoundsGEP2_64(BufTy, buf, 0, it.second);
+      Value *src = IRB.CreatePointerCast(it.first, I8PtrTy);
+      createMemCpy(IRB, dst, src, DL.getTypeAllocSize(Ty));
+    }
+  };
+
+  auto checkC = M->getOrInsertFunction("__INSTR_check_nontermination_mem",
+                                       Type::getVoidTy(Ctx), // retval
+                                       I8PtrTy, // current state
+                                       I8PtrTy, // snapshot
+                                       SizeTy   // size
+#if LLVM_VERSION_MAJOR < 5
+                                       , nullptr
+#endif
+                                       );
+
+  std::vector<BasicBlock *> preds(pred_begin(header), pred_end(header));
+  for (auto *pred : preds) {
+    auto *term = pred->getTerminator();
+    IRBuilder<> IRB(term);
+    IRB.SetCurrentDebugLocation(term->getDebugLoc());
+
+    if (!L->contains(pred)) {
+      // entering the loop, take the snapshot
+      copyState(IRB, snapshot);
+      continue;
+    }
+
+#if LLVM_VERSION_MAJOR > 7
+    auto md = term->getPrevNonDebugInstruction();
+    if (!md || !md->hasMetadata())
+        md = term;
+#else
+    auto md = term;
+#endif
+
+    copyState(IRB, state);
+    Value *statePtr = IRB.CreatePointerCast(state, I8PtrTy);
+    Value *snapshotPtr = IRB.CreatePointerCast(snapshot, I8PtrTy);
+    auto *CI = IRB.CreateCall(checkC, {statePtr, snapshotPtr,
+                                       ConstantInt::get(SizeTy, size)});
+    CloneMetadata(md, CI);
+    createMemCpy(IRB, snapshotPtr, statePtr, size);
+  }
+
+  if (insertHeader) {
+      auto *CI = CallInst::Create(getHeaderFun(M));
+      CloneMetadata(header->getTerminator(), CI);
+      CI->insertBefore(header->getTerminator());
+  }
+
+  llvm::errs() << "Instrumented a loop with non-termination checks "
+                  "(snapshot of " << layout.size() << " variables)\n";
+  return true;
+}
+
 bool InstrumentNontermination::instrumentEmptyLoop(Loop *L) {
   auto *header = L->getHeader();
 
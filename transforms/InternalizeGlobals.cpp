@@ -15,21 +15,35 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
 #include "llvm/IR/Type.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 #include <llvm/IR/DebugInfoMetadata.h>
 
+#include "SplitNondet.h"
+
 using namespace llvm;
 
+static cl::opt<bool> lazy("internalize-globals-lazy",
+        cl::desc("Make external globals non-deterministic at their first "
+                 "access instead of at the beginning of main. Globals that "
+                 "are never read are not made non-deterministic at all."),
+        cl::init(false));
+
 bool CloneMetadata(const llvm::Instruction *, llvm::Instruction *);
 
 class InternalizeGlobals : public ModulePass {
     Function *_vms = nullptr; // verifier_make_nondet function
+    Function *_vms_lazy = nullptr; // verifier_make_nondet_lazy function
     Type *_size_t_Ty = nullptr; // type of size_t
 
     std::unique_ptr<DataLayout> DL;
 
     Function *get_verifier_make_nondet(Module *);
+    Function *get_verifier_make_nondet_lazy(Module *);
     Type *get_size_t(Module *);
+    Constant *getNameString(Module&, GlobalVariable *,
+                            const std::string& suffix = "");
+    bool initializeLazily(Module&, GlobalVariable *);
     bool initializeExternalGlobals(Module&);
   public:
     static char ID;
@@ -125,20 +139,19 @@ bool InternalizeGlobals::initializeExternalGlobals(Module& M) {
       }
     }
 
+    // make it writable as we're going to inicialize it
+    GV->setExternallyInitialized(false);
+    GV->setConstant(false);
+    modified = true;
+
+    // the pointed memory is accessed via loaded pointers that we do not
+    // track, so only globals that are not pointers can be initialized lazily
+    if (lazy && memory == GV && initializeLazily(M, GV))
+      continue;
+
     Function *vms = get_verifier_make_nondet(&M);
     CastInst *CastI = CastInst::CreatePointerCast(memory, Type::getInt8PtrTy(Ctx));
 
-    std::vector<Value *> args;
-    args.push_back(CastI);
-    args.push_back(ConstantInt::get(get_size_t(&M), DL->getTypeAllocSize(Ty)));
-    std::string nameStr = GV->hasName() ? GV->getName().str() : "extern-global";
-    Constant *name
-        = ConstantDataArray::getString(Ctx, nameStr);
-    GlobalVariable *nameG = new GlobalVariable(M, name->getType(), true /*constant */,
-                                               GlobalVariable::PrivateLinkage, name);
-    args.push_back(ConstantExpr::getPointerCast(nameG, Type::getInt8PtrTy(Ctx)));
-    CallInst *CI = CallInst::Create(vms, args);
-
     Function *main = M.getFunction("main");
     assert(main && "Do not have main");
     BasicBlock& block = main->getBasicBlockList().front();
@@ -146,22 +159,141 @@ bool InternalizeGlobals::initializeExternalGlobals(Module& M) {
     // this function
     Instruction& Inst = *(block.begin());
     CastI->insertBefore(&Inst);
-    CI->insertBefore(&Inst);
 
-    // add metadata due to the inliner pass
-    CloneMetadata(&Inst, CI);
+    // small structs and arrays are made symbolic field by field,
+    // the objects are named g.0, g[1], ... KLEE can make symbolic
+    // only whole objects, so every field gets a new object that is
+    // made nondeterministic and copied into the field
+    std::vector<NondetField> fields;
+    if (!getNondetFields(*DL, Ty, fields)) {
+      std::vector<Value *> args;
+      args.push_back(CastI);
+      args.push_back(ConstantInt::get(get_size_t(&M), DL->getTypeAllocSize(Ty)));
+      args.push_back(getNameString(M, GV));
+      CallInst *CI = CallInst::Create(vms, args, "", &Inst);
+
+      // add metadata due to the inliner pass
+      CloneMetadata(&Inst, CI);
+    }
 
-    modified = true;
+    for (auto& field : fields) {
+      Value *addr = CastI;
+      if (field.offset > 0) {
+        auto *GEP = GetElementPtrInst::CreateInBounds(
+            Type::getInt8Ty(Ctx), CastI,
+            ConstantInt::get(get_size_t(&M), field.offset), "", &Inst);
+        CloneMetadata(&Inst, GEP);
+        addr = GEP;
+      }
+
+      AllocaInst *obj = createFieldObject(*DL, field.size, &Inst);
+      CloneMetadata(&Inst, obj);
+      CastInst *objCast = CastInst::CreatePointerCast(
+          obj, Type::getInt8PtrTy(Ctx), "", &Inst);
+      CloneMetadata(&Inst, objCast);
+
+      std::vector<Value *> args;
+      args.push_back(objCast);
+      args.push_back(ConstantInt::get(get_size_t(&M), field.size));
+      args.push_back(getNameString(M, GV, field.suffix));
+      CallInst *CI = CallInst::Create(vms, args, "", &Inst);
+      CloneMetadata(&Inst, CI);
+      CloneMetadata(&Inst, createFieldCopy(addr, objCast, field.size, &Inst));
+    }
 
-    GV->setExternallyInitialized(false);
-    // make it writable as we're going to inicialize it in main
-    GV->setConstant(false);
     errs() << "Made global variable '" << GV->getName() << "' non-extern\n";
   }
 
   return modified;
 }
 
+// Gather the loads and stores of the memory of the global.
+// Return false if the global is used in any other way
+// (e.g., its address is stored or passed to a function).
+static bool collectAccesses(Value *V, std::vector<Instruction *>& accesses) {
+  for (auto *U : V->users()) {
+    if (isa<LoadInst>(U)) {
+      accesses.push_back(cast<Instruction>(U));
+    } else if (auto *SI = dyn_cast<StoreInst>(U)) {
+      if (SI->getValueOperand() == V)
+        return false;
+      accesses.push_back(SI);
+    } else if (isa<GetElementPtrInst>(U) || isa<BitCastInst>(U)) {
+      if (!collectAccesses(U, accesses))
+        return false;
+    } else if (auto *CE = dyn_cast<ConstantExpr>(U)) {
+      if (CE->getOpcode() != Instruction::GetElementPtr &&
+          CE->getOpcode() != Instruction::BitCast)
+        return false;
+      if (!collectAccesses(CE, accesses))
+        return false;
+    } else {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Insert the initialization of the global before each of its accesses.
+// The initialization is guarded by a flag, so it is done only once.
+// If the global is never read, it does not need to be initialized at all.
+bool InternalizeGlobals::initializeLazily(Module& M, GlobalVariable *GV) {
+  std::vector<Instruction *> accesses;
+  if (!collectAccesses(GV, accesses))
+    return false;
+
+  bool isRead = false;
+  for (auto *I : accesses) {
+    if (isa<LoadInst>(I)) {
+      isRead = true;
+      break;
+    }
+  }
+
+  if (!isRead) {
+    errs() << "Global variable '" << GV->getName() << "' is never read, "
+              "not making it non-deterministic\n";
+    return true;
+  }
+
+  LLVMContext& Ctx = M.getContext();
+  Type *I8 = Type::getInt8Ty(Ctx);
+  GlobalVariable *flag = new GlobalVariable(M, I8, false /*constant */,
+                                            GlobalVariable::PrivateLinkage,
+                                            ConstantInt::get(I8, 0),
+                                            GV->getName() + ".initialized");
+  Function *vms = get_verifier_make_nondet_lazy(&M);
+  Value *args[] = {
+    ConstantExpr::getPointerCast(GV, Type::getInt8PtrTy(Ctx)),
+    ConstantInt::get(get_size_t(&M), DL->getTypeAllocSize(GV->getValueType())),
+    getNameString(M, GV),
+    flag
+  };
+
+  for (auto *I : accesses) {
+    CallInst *CI = CallInst::Create(vms, args);
+    CI->insertBefore(I);
+    CloneMetadata(I, CI);
+  }
+
+  errs() << "Made global variable '" << GV->getName()
+         << "' non-extern (lazily)\n";
+  return true;
+}
+
+Constant *InternalizeGlobals::getNameString(Module& M, GlobalVariable *GV,
+                                            const std::string& suffix) {
+  LLVMContext& Ctx = M.getContext();
+  std::string nameStr = GV->hasName() ? GV->getName().str() : "extern-global";
+  nameStr += suffix;
+  Constant *name
+      = ConstantDataArray::getString(Ctx, nameStr);
+  GlobalVariable *nameG = new GlobalVariable(M, name->getType(), true /*constant */,
+                                             GlobalVariable::PrivateLinkage, name);
+  return ConstantExpr::getPointerCast(nameG, Type::getInt8PtrTy(Ctx));
+}
+
 Function *InternalizeGlobals::get_verifier_make_nondet(llvm::Module *M)
 {
   if (_vms)
@@ -188,6 +320,33 @@ Function *InternalizeGlobals::get_verifier_make_nondet(llvm::Module *M)
   return _vms;
 }
 
+Function *InternalizeGlobals::get_verifier_make_nondet_lazy(llvm::Module *M)
+{
+  if (_vms_lazy)
+    return _vms_lazy;
+
+  LLVMContext& Ctx = M->getContext();
+  //void __VERIFIER_make_nondet_lazy(void *addr, size_t nbytes,
+  //                                 const char *name, char *initialized);
+  auto C = M->getOrInsertFunction("__VERIFIER_make_nondet_lazy",
+                                   Type::getVoidTy(Ctx),
+                                   Type::getInt8PtrTy(Ctx), // addr
+                                   get_size_t(M),   // nbytes
+                                   Type::getInt8PtrTy(Ctx), // name
+                                   Type::getInt8PtrTy(Ctx) // initialized
+#if LLVM_VERSION_MAJOR < 5
+                                   , nullptr
+#endif
+                                   );
+#if LLVM_VERSION_MAJOR >= 9
+  _vms_lazy = cast<Function>(C.getCallee());
+#else
+  _vms_lazy = cast<Function>(C);
+#endif
+
+  return _vms_lazy;
+}
+
 Type *InternalizeGlobals::get_size_t(llvm::Module *M)
 {
   if (_size_t_Ty)
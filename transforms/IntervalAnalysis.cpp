@@ -0,0 +1,542 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <cassert>
+#include <vector>
+
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/ADT/PostOrderIterator.h"
+
+#include "IntervalAnalysis.h"
+
+using namespace llvm;
+
+static ConstantRange fullRange(const Value *V) {
+  return ConstantRange::getFull(V->getType()->getIntegerBitWidth());
+}
+
+// the range of values returned by an undefined function
+static ConstantRange declarationRange(const Function *F) {
+  auto *Ty = F->getReturnType();
+  unsigned bw = Ty->getIntegerBitWidth();
+  auto name = F->getName();
+  if (bw > 1 && name.startswith("__VERIFIER_nondet_") &&
+      (name.endswith("_bool") || name.endswith("_Bool"))) {
+    return ConstantRange(APInt(bw, 0), APInt(bw, 2));
+  }
+  return ConstantRange::getFull(bw);
+}
+
+// Check whether the arithmetic operation may overflow. We do the operation
+// in a wider bit-width where it cannot overflow and then check whether
+// the result fits into the original type.
+static bool mayOverflow(Intrinsic::ID id, const ConstantRange& L,
+                        const ConstantRange& R) {
+  unsigned bw = L.getBitWidth();
+  unsigned wide = 2 * bw + 2;
+  bool isSigned = false;
+  Instruction::BinaryOps op;
+  switch (id) {
+    case Intrinsic::sadd_with_overflow: isSigned = true; op = Instruction::Add; break;
+    case Intrinsic::uadd_with_overflow: op = Instruction::Add; break;
+    case Intrinsic::ssub_with_overflow: isSigned = true; op = Instruction::Sub; break;
+    case Intrinsic::usub_with_overflow: op = Instruction::Sub; break;
+    case Intrinsic::smul_with_overflow: isSigned = true; op = Instruction::Mul; break;
+    case Intrinsic::umul_with_overflow: op = Instruction::Mul; break;
+    default:
+      return true;
+  }
+
+  ConstantRange WL = isSigned ? L.signExtend(wide) : L.zeroExtend(wide);
+  ConstantRange WR = isSigned ? R.signExtend(wide) : R.zeroExtend(wide);
+  ConstantRange Res = WL.binaryOp(op, WR);
+  ConstantRange Full = ConstantRange::getFull(bw);
+  ConstantRange Allowed = isSigned ? Full.signExtend(wide) : Full.zeroExtend(wide);
+  return !Allowed.contains(Res);
+}
+
+static Instruction::BinaryOps overflowOpcode(Intrinsic::ID id) {
+  switch (id) {
+    case Intrinsic::sadd_with_overflow:
+    case Intrinsic::uadd_with_overflow:
+      return Instruction::Add;
+    case Intrinsic::ssub_with_overflow:
+    case Intrinsic::usub_with_overflow:
+      return Instruction::Sub;
+    default:
+      return Instruction::Mul;
+  }
+}
+
+static bool isOverflowIntrinsic(Intrinsic::ID id) {
+  switch (id) {
+    case Intrinsic::sadd_with_overflow:
+    case Intrinsic::uadd_with_overflow:
+    case Intrinsic::ssub_with_overflow:
+    case Intrinsic::usub_with_overflow:
+    case Intrinsic::smul_with_overflow:
+    case Intrinsic::umul_with_overflow:
+      return true;
+    default:
+      return false;
+  }
+}
+
+class IntervalAnalysis::Solver {
+  IntervalAnalysis& IA;
+  FunctionResult& R;
+
+  std::vector<const Instruction *> worklist;
+  std::set<const Instruction *> inWorklist;
+  std::map<const Instruction *, unsigned> updates;
+  uint64_t budget{0};
+  bool descending{false};
+
+  void push(const Instruction *I) {
+    if (inWorklist.insert(I).second)
+      worklist.push_back(I);
+  }
+
+  void pushUsers(const Value *V) {
+    for (auto *U : V->users()) {
+      auto *UI = dyn_cast<Instruction>(U);
+      if (!UI)
+        continue;
+      push(UI);
+      // the value is used for refining the other operand of the comparison
+      // in the successors of a branch, so re-evaluate the users of that
+      // operand too
+      if (auto *IC = dyn_cast<ICmpInst>(UI)) {
+        const Value *other = IC->getOperand(0) == V ? IC->getOperand(1)
+                                                    : IC->getOperand(0);
+        if (isa<Instruction>(other) || isa<Argument>(other)) {
+          for (auto *OU : other->users())
+            if (auto *OUI = dyn_cast<Instruction>(OU))
+              push(OUI);
+        }
+      }
+    }
+  }
+
+  void markEdge(const BasicBlock *From, const BasicBlock *To) {
+    if (!R.feasibleEdges.insert({From, To}).second)
+      return;
+
+    if (R.reachable.insert(To).second) {
+      for (auto& I : *To)
+        push(&I);
+    } else {
+      for (auto& P : To->phis())
+        push(&P);
+    }
+  }
+
+  // refine the range of V by the fact that the condition Cond has the value Taken
+  ConstantRange applyCondition(const Value *Cond, bool Taken,
+                               const Value *V, ConstantRange CR,
+                               unsigned depth) {
+    if (auto *IC = dyn_cast<ICmpInst>(Cond)) {
+      auto pred = Taken ? IC->getPredicate() : IC->getInversePredicate();
+      const Value *other = nullptr;
+      if (IC->getOperand(0) == V) {
+        other = IC->getOperand(1);
+      } else if (IC->getOperand(1) == V) {
+        other = IC->getOperand(0);
+        pred = ICmpInst::getSwappedPredicate(pred);
+      }
+      if (!other || !other->getType()->isIntegerTy())
+        return CR;
+      return CR.intersectWith(
+              ConstantRange::makeAllowedICmpRegion(pred, get(other)));
+    }
+
+    if (depth == 0)
+      return CR;
+
+    // (a && b) is true or (a || b) is false -- both a and b hold
+    if (auto *BO = dyn_cast<BinaryOperator>(Cond)) {
+      if ((Taken && BO->getOpcode() == Instruction::And) ||
+          (!Taken && BO->getOpcode() == Instruction::Or)) {
+        CR = applyCondition(BO->getOperand(0), Taken, V, CR, depth - 1);
+        return applyCondition(BO->getOperand(1), Taken, V, CR, depth - 1);
+      }
+    }
+
+    return CR;
+  }
+
+  ConstantRange refineByEdge(const Value *V, ConstantRange CR,
+                             const BasicBlock *From, const BasicBlock *To) {
+    auto *BI = dyn_cast<BranchInst>(From->getTerminator());
+    if (!BI || !BI->isConditional())
+      return CR;
+    if (BI->getSuccessor(0) == BI->getSuccessor(1))
+      return CR;
+    return applyCondition(BI->getCondition(), BI->getSuccessor(0) == To,
+                          V, CR, 2);
+  }
+
+public:
+  Solver(IntervalAnalysis& IA, FunctionResult& R) : IA(IA), R(R) {}
+
+  // the raw (unrefined) range of the value
+  ConstantRange get(const Value *V) {
+    if (auto *C = dyn_cast<ConstantInt>(V))
+      return ConstantRange(C->getValue());
+    // undef may be any value
+    if (isa<UndefValue>(V))
+      return fullRange(V);
+    if (isa<Instruction>(V)) {
+      auto it = R.values.find(V);
+      if (it != R.values.end())
+        return it->second;
+      // not computed yet (or unreachable)
+      return ConstantRange::getEmpty(V->getType()->getIntegerBitWidth());
+    }
+    return fullRange(V);
+  }
+
+  // the range of V at the beginning of the block B
+  ConstantRange getAt(const Value *V, const BasicBlock *B) {
+    ConstantRange CR = get(V);
+    if (isa<Constant>(V) || CR.isEmptySet() || !B || !R.DT)
+      return CR;
+
+    const BasicBlock *cur = B;
+    for (unsigned n = 0; n < IA.refineDepth; ++n) {
+      auto *node = R.DT->getNode(cur);
+      if (!node || !node->getIDom())
+        break;
+      auto *pred = cur->getUniquePredecessor();
+      if (pred)
+        CR = refineByEdge(V, CR, pred, cur);
+      cur = node->getIDom()->getBlock();
+    }
+    return CR;
+  }
+
+  ConstantRange getOnEdge(const Value *V, const BasicBlock *From,
+                          const BasicBlock *To) {
+    return refineByEdge(V, getAt(V, From), From, To);
+  }
+
+private:
+  void visitTerminator(const Instruction *T) {
+    const BasicBlock *B = T->getParent();
+    if (auto *BI = dyn_cast<BranchInst>(T)) {
+      if (!BI->isConditional()) {
+        markEdge(B, BI->getSuccessor(0));
+        return;
+      }
+      ConstantRange C = getAt(BI->getCondition(), B);
+      if (C.contains(APInt(1, 1)))
+        markEdge(B, BI->getSuccessor(0));
+      if (C.contains(APInt(1, 0)))
+        markEdge(B, BI->getSuccessor(1));
+      return;
+    }
+
+    if (auto *SI = dyn_cast<SwitchInst>(T)) {
+      ConstantRange C = getAt(SI->getCondition(), B);
+      if (C.isEmptySet())
+        return;
+      // the case values are distinct, so the default edge is infeasible
+      // only if the number of the case values in C is the size of C
+      uint64_t covered = 0;
+      for (auto& Case : SI->cases()) {
+        const APInt& val = Case.getCaseValue()->getValue();
+        if (C.contains(val)) {
+          markEdge(B, Case.getCaseSuccessor());
+          ++covered;
+        }
+      }
+      if (C.isFullSet() ||
+          (C.getUpper() - C.getLower()).ugt(APInt(C.getBitWidth(), covered)))
+        markEdge(B, SI->getDefaultDest());
+      return;
+    }
+
+    for (auto *succ : successors(B))
+      markEdge(B, succ);
+  }
+
+  ConstantRange evaluate(const Instruction *I) {
+    const BasicBlock *B = I->getParent();
+
+    if (auto *P = dyn_cast<PHINode>(I)) {
+      ConstantRange CR = ConstantRange::getEmpty(I->getType()->getIntegerBitWidth());
+      for (unsigned i = 0, e = P->getNumIncomingValues(); i < e; ++i) {
+        auto *pred = P->getIncomingBlock(i);
+        if (!R.feasibleEdges.count({pred, B}))
+          continue;
+        CR = CR.unionWith(getOnEdge(P->getIncomingValue(i), pred, B));
+      }
+      return CR;
+    }
+
+    if (auto *BO = dyn_cast<BinaryOperator>(I)) {
+      return getAt(BO->getOperand(0), B).binaryOp(BO->getOpcode(),
+                                                  getAt(BO->getOperand(1), B));
+    }
+
+    if (auto *CI = dyn_cast<CastInst>(I)) {
+      if (!CI->getSrcTy()->isIntegerTy())
+        return fullRange(I);
+      return getAt(CI->getOperand(0), B).castOp(CI->getOpcode(),
+                                                I->getType()->getIntegerBitWidth());
+    }
+
+    if (auto *IC = dyn_cast<ICmpInst>(I)) {
+      if (!IC->getOperand(0)->getType()->isIntegerTy())
+        return fullRange(I);
+      ConstantRange L = getAt(IC->getOperand(0), B);
+      ConstantRange Rr = getAt(IC->getOperand(1), B);
+      if (L.isEmptySet() || Rr.isEmptySet())
+        return ConstantRange::getEmpty(1);
+      if (ConstantRange::makeSatisfyingICmpRegion(IC->getPredicate(), Rr).contains(L))
+        return ConstantRange(APInt(1, 1));
+      if (ConstantRange::makeAllowedICmpRegion(IC->getPredicate(), Rr)
+              .intersectWith(L).isEmptySet())
+        return ConstantRange(APInt(1, 0));
+      return fullRange(I);
+    }
+
+    if (auto *S = dyn_cast<SelectInst>(I)) {
+      const Value *cond = S->getCondition();
+      ConstantRange C = getAt(cond, B);
+      ConstantRange CR = ConstantRange::getEmpty(I->getType()->getIntegerBitWidth());
+      if (C.getBitWidth() != 1)
+        return getAt(S->getTrueValue(), B).unionWith(getAt(S->getFalseValue(), B));
+      // the chosen value is refined by the condition like on a branch
+      if (C.contains(APInt(1, 1))) {
+        const Value *V = S->getTrueValue();
+        CR = CR.unionWith(applyCondition(cond, true, V, getAt(V, B), 2));
+      }
+      if (C.contains(APInt(1, 0))) {
+        const Value *V = S->getFalseValue();
+        CR = CR.unionWith(applyCondition(cond, false, V, getAt(V, B), 2));
+      }
+      return CR;
+    }
+
+    if (auto *EV = dyn_cast<ExtractValueInst>(I)) {
+      auto *II = dyn_cast<IntrinsicInst>(EV->getAggregateOperand());
+      if (!II || !isOverflowIntrinsic(II->getIntrinsicID()) ||
+          EV->getNumIndices() != 1)
+        return fullRange(I);
+      ConstantRange L = getAt(II->getArgOperand(0), B);
+      ConstantRange Rr = getAt(II->getArgOperand(1), B);
+      if (L.isEmptySet() || Rr.isEmptySet())
+        return ConstantRange::getEmpty(I->getType()->getIntegerBitWidth());
+      if (EV->getIndices()[0] == 0)
+        return L.binaryOp(overflowOpcode(II->getIntrinsicID()), Rr);
+      if (mayOverflow(II->getIntrinsicID(), L, Rr))
+        return fullRange(I);
+      return ConstantRange(APInt(1, 0));
+    }
+
+    if (auto *CI = dyn_cast<CallInst>(I)) {
+      auto *F = CI->getCalledFunction();
+      if (!F)
+        return fullRange(I);
+      if (auto *II = dyn_cast<IntrinsicInst>(CI)) {
+        auto id = II->getIntrinsicID();
+        if (ConstantRange::isIntrinsicSupported(id)) {
+          SmallVector<ConstantRange, 2> ops;
+          for (auto& arg : II->args()) {
+            if (!arg->getType()->isIntegerTy())
+              return fullRange(I);
+            ops.push_back(getAt(arg, B));
+          }
+          return ConstantRange::intrinsic(id, ops);
+        }
+        return fullRange(I);
+      }
+      return IA.getReturnSummary(F);
+    }
+
+    return fullRange(I);
+  }
+
+  static ConstantRange widen(const ConstantRange& Old, const ConstantRange& New) {
+    if (Old.isEmptySet() || New.isFullSet())
+      return New;
+    unsigned bw = New.getBitWidth();
+    APInt lo = Old.getSignedMin(), hi = Old.getSignedMax();
+    if (New.getSignedMin().slt(lo))
+      lo = APInt::getSignedMinValue(bw);
+    if (New.getSignedMax().sgt(hi))
+      hi = APInt::getSignedMaxValue(bw);
+    return ConstantRange::getNonEmpty(lo, hi + 1);
+  }
+
+  void update(const Instruction *I, ConstantRange New) {
+    auto it = R.values.find(I);
+    if (it == R.values.end()) {
+      R.values.emplace(I, New);
+      pushUsers(I);
+      return;
+    }
+
+    ConstantRange& Old = it->second;
+    if (descending) {
+      New = New.intersectWith(Old);
+    } else {
+      New = New.unionWith(Old);
+      if (New != Old && isa<PHINode>(I) && ++updates[I] > IA.widenDelay)
+        New = widen(Old, New);
+    }
+
+    if (New == Old)
+      return;
+    Old = New;
+    pushUsers(I);
+  }
+
+  void visit(const Instruction *I) {
+    if (!R.reachable.count(I->getParent()))
+      return;
+
+    if (I->isTerminator()) {
+      visitTerminator(I);
+      return;
+    }
+
+    if (!I->getType()->isIntegerTy())
+      return;
+
+    update(I, evaluate(I));
+  }
+
+public:
+  void run(Function& F) {
+    unsigned ninst = 0;
+    for (auto& B : F)
+      ninst += B.size();
+    budget = static_cast<uint64_t>(IA.maxVisits) * ninst;
+
+    auto& entry = F.getEntryBlock();
+    R.reachable.insert(&entry);
+    for (auto& I : entry)
+      push(&I);
+
+    while (!worklist.empty()) {
+      if (budget-- == 0) {
+        R.valid = false;
+        return;
+      }
+      auto *I = worklist.back();
+      worklist.pop_back();
+      inWorklist.erase(I);
+      visit(I);
+    }
+
+    // descending iterations to recover precision lost by widening
+    descending = true;
+    ReversePostOrderTraversal<Function *> RPOT(&F);
+    for (unsigned n = 0; n < 2; ++n) {
+      for (auto *B : RPOT) {
+        if (!R.reachable.count(B))
+          continue;
+        for (auto& I : *B) {
+          if (!I.isTerminator() && I.getType()->isIntegerTy())
+            update(&I, evaluate(&I));
+        }
+      }
+    }
+
+    R.valid = true;
+  }
+};
+
+const IntervalAnalysis::FunctionResult& IntervalAnalysis::analyze(Function& F) {
+  auto it = results.find(&F);
+  if (it != results.end())
+    return *it->second;
+
+  auto& R = results[&F];
+  R.reset(new FunctionResult());
+  if (F.isDeclaration())
+    return *R;
+
+  R->DT.reset(new DominatorTree(F));
+  Solver S(*this, *R);
+  S.run(F);
+  return *R;
+}
+
+ConstantRange IntervalAnalysis::getRange(const Value *V, const BasicBlock *B) {
+  assert(V->getType()->isIntegerTy());
+  if (auto *C = dyn_cast<ConstantInt>(V))
+    return ConstantRange(C->getValue());
+
+  const Function *F = nullptr;
+  if (B)
+    F = B->getParent();
+  else if (auto *I = dyn_cast<Instruction>(V))
+    F = I->getFunction();
+
+  auto it = results.find(F);
+  if (it == results.end() || !it->second->valid)
+    return fullRange(V);
+
+  Solver S(*this, *it->second);
+  return B ? S.getAt(V, B) : S.get(V);
+}
+
+bool IntervalAnalysis::isReachable(const BasicBlock *B) {
+  auto it = results.find(B->getParent());
+  if (it == results.end() || !it->second->valid)
+    return true;
+  return it->second->reachable.count(B) > 0;
+}
+
+bool IntervalAnalysis::isFeasibleEdge(const BasicBlock *From, const BasicBlock *To) {
+  auto it = results.find(From->getParent());
+  if (it == results.end() || !it->second->valid)
+    return true;
+  return it->second->feasibleEdges.count({From, To}) > 0;
+}
+
+ConstantRange IntervalAnalysis::getReturnSummary(Function *F) {
+  assert(F->getReturnType()->isIntegerTy());
+  auto it = summaries.find(F);
+  if (it != summaries.end())
+    return it->second;
+
+  unsigned bw = F->getReturnType()->getIntegerBitWidth();
+  if (F->isDeclaration())
+    return declarationRange(F);
+
+  // recursive call, we do not know anything
+  if (!inProgress.insert(F).second)
+    return ConstantRange::getFull(bw);
+
+  const auto& R = analyze(*F);
+  ConstantRange CR = ConstantRange::getEmpty(bw);
+  if (!R.valid) {
+    CR = ConstantRange::getFull(bw);
+  } else {
+    for (auto& B : *F) {
+      if (!R.reachable.count(&B))
+        continue;
+      if (auto *RI = dyn_cast<ReturnInst>(B.getTerminator()))
+        CR = CR.unionWith(getRange(RI->getReturnValue(), &B));
+    }
+  }
+
+  inProgress.erase(F);
+  summaries.emplace(F, CR);
+  return CR;
+}
+
+void IntervalAnalysis::invalidate(Function& F) {
+  results.erase(&F);
+}
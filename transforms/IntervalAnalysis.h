@@ -0,0 +1,83 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef SBT_INTERVAL_ANALYSIS_H_
+#define SBT_INTERVAL_ANALYSIS_H_
+
+#include <map>
+#include <memory>
+#include <set>
+#include <utility>
+
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/ConstantRange.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+
+/** Sparse interval analysis over SSA values.
+ *
+ * Every integer SSA value of a function gets one (possibly wrapped)
+ * interval. Values are computed by a worklist algorithm that keeps track
+ * of feasible CFG edges (like SCCP does), refines operands by the
+ * conditions of dominating branches and widens PHI nodes in loop headers
+ * after a few updates. A descending pass then recovers the bounds lost by
+ * widening. Memory is not tracked, loads yield the full range.
+ *
+ * Calls to defined functions are approximated by a summary of the
+ * returned value that is computed (context-insensitively) on demand and
+ * cached for the whole module.
+ *
+ * The analysis has a budget of visits per instruction. If the budget
+ * is exhausted, the function is treated as if nothing was known about it.
+ */
+class IntervalAnalysis {
+public:
+  using Edge = std::pair<const llvm::BasicBlock *, const llvm::BasicBlock *>;
+
+  struct FunctionResult {
+    std::map<const llvm::Value *, llvm::ConstantRange> values;
+    std::set<Edge> feasibleEdges;
+    std::set<const llvm::BasicBlock *> reachable;
+    std::unique_ptr<llvm::DominatorTree> DT;
+    // false if the budget was exhausted, all queries are then conservative
+    bool valid{false};
+  };
+
+  IntervalAnalysis(unsigned maxVisits = 8, unsigned widenDelay = 2,
+                   unsigned refineDepth = 8)
+  : maxVisits(maxVisits), widenDelay(widenDelay), refineDepth(refineDepth) {}
+
+  /// Analyze the function (if not analyzed yet) and return the results
+  const FunctionResult& analyze(llvm::Function& F);
+
+  /// Range of V at the beginning of block B (refined by dominating branches).
+  /// Requires that the function of B has been analyzed.
+  llvm::ConstantRange getRange(const llvm::Value *V,
+                               const llvm::BasicBlock *B = nullptr);
+
+  bool isReachable(const llvm::BasicBlock *B);
+  bool isFeasibleEdge(const llvm::BasicBlock *From, const llvm::BasicBlock *To);
+
+  /// Summary of the returned value of F
+  llvm::ConstantRange getReturnSummary(llvm::Function *F);
+
+  /// Drop the results for F (call after F has been modified).
+  /// The summary of F is kept.
+  void invalidate(llvm::Function& F);
+
+private:
+  const unsigned maxVisits;
+  const unsigned widenDelay;
+  const unsigned refineDepth;
+
+  std::map<const llvm::Function *, std::unique_ptr<FunctionResult>> results;
+  std::map<const llvm::Function *, llvm::ConstantRange> summaries;
+  std::set<const llvm::Function *> inProgress;
+
+  class Solver;
+};
+
+#endif // SBT_INTERVAL_ANALYSIS_H_
@@ -16,6 +16,8 @@
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/LoopUtils.h"
 
+#include "LoopMetadata.h"
+
 using namespace llvm;
 
 static cl::opt<unsigned> MaxBackedgeCount(
@@ -128,6 +130,13 @@ PHINode *insertBackedgeTakenCount(Loop *L, DomTreeUpdater *DTU, LoopInfo *LI,
 bool InductiveBase::runOnLoop(Loop *L, LPPassManager & /*LPM*/) {
   if (MaxBackedgeCount == 0) return false;
 
+  // the loop never takes more backedges than the bound (as found by
+  // -classify-loops-annotate), so there is nothing to cut off
+  SbtLoopInfo info;
+  if (getSbtLoopInfo(L, info) && info.tripBound > 0 &&
+      info.tripBound - 1 <= MaxBackedgeCount)
+    return false;
+
   BasicBlock *Header = L->getHeader();
   BasicBlock *Preheader = L->getLoopPreheader();
   Function *F = Header->getParent();
@@ -0,0 +1,48 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef SBT_LOOP_METADATA_H_
+#define SBT_LOOP_METADATA_H_
+
+#include <vector>
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/GlobalVariable.h"
+
+/** Properties of a loop that are computed by -classify-loops-annotate.
+ *
+ * They are stored as !sbt.loop metadata on the terminator of the loop
+ * header, so that they survive between opt invocations and the loop passes
+ * do not need to analyse the loops again. (The latches are not used,
+ * because one block can be a latch of several nested loops.)
+ * The metadata is a flat list of key-value pairs:
+ *
+ *   !{!"exits", i32 1, !"trip", i64 10, !"depth", i32 1,
+ *     !"irreducible", i1 false, !"pure", i1 true,
+ *     !"modifies-unknown", i1 false, !"modifies-locals", i32 2,
+ *     !"modifies", !{i32* @g}}
+ *
+ * A trip bound of 0 means that it is unknown.
+ */
+struct SbtLoopInfo {
+  unsigned exits{0};
+  // the maximal number of executions of the header (0 if unknown)
+  uint64_t tripBound{0};
+  unsigned depth{0};
+  bool irreducible{false};
+  // the loop does not write to memory outside of the function
+  bool pure{false};
+  // the loop writes to memory that is not a local variable or a global
+  bool modifiesUnknown{false};
+  // the number of modified local variables
+  unsigned modifiedLocals{0};
+  std::vector<llvm::GlobalVariable *> modifiedGlobals;
+};
+
+void setSbtLoopInfo(llvm::Loop *L, const SbtLoopInfo& info);
+// return false if the loop has no (or malformed) metadata
+bool getSbtLoopInfo(const llvm::Loop *L, SbtLoopInfo& info);
+
+#endif // SBT_LOOP_METADATA_H_
@@ -10,6 +10,7 @@
 #include <fstream>
 #include <sstream>
 
+#include "llvm/Analysis/DemandedBits.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Constants.h"
@@ -31,6 +32,9 @@
 
 using namespace llvm;
 
+uint64_t getDemandedBytes(const DataLayout& DL, DemandedBits& DB,
+                          Instruction *I);
+
 static cl::opt<std::string> source_name("make-nondet-source",
                                         cl::desc("Specify source filename"),
                                         cl::value_desc("filename"));
@@ -41,6 +45,8 @@ class MakeNondet : public ModulePass {
   std::vector<std::pair<unsigned, CallInst *>> calls_to_replace;
   std::vector<std::pair<unsigned, CallInst *>> allocs_to_handle;
   std::set<unsigned> lines_nums;
+  // how many bytes of the nondet values the program may observe
+  std::map<CallInst *, uint64_t> demanded_bytes;
   std::map<unsigned, std::string> lines;
   Function *_vms = nullptr; // verifier_make_symbolic function
   Type *_size_t_Ty = nullptr; // type of size_t
@@ -62,6 +68,11 @@ public:
   static char ID;
 
   MakeNondet() : ModulePass(ID) {}
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DemandedBitsWrapperPass>();
+  }
+
   void runOnFunction(Function &F);
   // must be module pass, so that we can iterate over
   // declarations too
@@ -81,6 +92,7 @@ void MakeNondet::runOnFunction(Function &F) {
   if (F.isDeclaration())
     return;
 
+  size_t first_call = calls_to_replace.size();
   for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
     if (CallInst *CI = dyn_cast<CallInst>(&*I)) {
 #if LLVM_VERSION_MAJOR >= 8
@@ -96,6 +108,17 @@ void MakeNondet::runOnFunction(Function &F) {
         handleCall(F, CI, !name.startswith("__VERIFIER"));
     }
   }
+
+  // compute the demanded bytes now, before we start changing the code
+  if (calls_to_replace.size() == first_call)
+    return;
+
+  auto& DB = getAnalysis<DemandedBitsWrapperPass>(F).getDemandedBits();
+  const DataLayout& DL = F.getParent()->getDataLayout();
+  for (size_t i = first_call; i < calls_to_replace.size(); ++i) {
+    CallInst *CI = calls_to_replace[i].second;
+    demanded_bytes[CI] = getDemandedBytes(DL, DB, CI);
+  }
 }
 
 void MakeNondet::handleCall(Function& /*F*/, CallInst *CI, bool ismalloc) {
@@ -151,14 +174,23 @@ void MakeNondet::replaceCall(Module& M, CallInst *CI,
   GlobalVariable *nameG = new GlobalVariable(M, name_const->getType(), true /*constant */,
                                              GlobalVariable::PrivateLinkage, name_const);
 
+  // make symbolic only the bytes that the program may observe,
+  // the value is zero-extended, so that the witness (that is
+  // generated from the symbolic bytes) has the same value
+  Type *Ty = CI->getType();
+  auto it = demanded_bytes.find(CI);
+  if (it != demanded_bytes.end() &&
+      it->second < M.getDataLayout().getTypeAllocSize(Ty))
+    Ty = IntegerType::get(M.getContext(), it->second * 8);
+
   AllocaInst *AI = new AllocaInst(
-      CI->getType(),
+      Ty,
 #if (LLVM_VERSION_MAJOR >= 5)
       0,
 #endif
       nullptr,
 #if LLVM_VERSION_MAJOR >= 11
-      M.getDataLayout().getPrefTypeAlign(CI->getType()),
+      M.getDataLayout().getPrefTypeAlign(Ty),
 #endif
       "",
       static_cast<Instruction*>(nullptr));
@@ -170,7 +202,7 @@ void MakeNondet::replaceCall(Module& M, CallInst *CI,
   args.push_back(CastI);
   // nbytes
   args.push_back(ConstantInt::get(get_size_t(M),
-                                  M.getDataLayout().getTypeAllocSize(CI->getType())));
+                                  M.getDataLayout().getTypeAllocSize(Ty)));
   // name
   args.push_back(ConstantExpr::getPointerCast(nameG,
                                               Type::getInt8PtrTy(M.getContext())));
@@ -198,7 +230,12 @@ void MakeNondet::replaceCall(Module& M, CallInst *CI,
   CastI->insertBefore(new_CI);
   AI->insertBefore(CastI);
   LI->insertAfter(new_CI);
-  CI->replaceAllUsesWith(LI);
+  if (Ty != CI->getType()) {
+    auto *Ext = new ZExtInst(LI, CI->getType(), name + ".zext");
+    Ext->insertAfter(LI);
+    CI->replaceAllUsesWith(Ext);
+  } else
+    CI->replaceAllUsesWith(LI);
   CI->eraseFromParent();
 }
 
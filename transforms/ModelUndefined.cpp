@@ -0,0 +1,442 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <cassert>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/IR/Type.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+static cl::opt<std::string> summariesFile("model-undefined-summaries",
+        cl::desc("JSON file with the summaries of undefined functions"),
+        cl::init(""));
+
+/*
+ * The summaries file is a JSON object that maps names of functions
+ * to their summaries, e.g.:
+ *
+ *  {
+ *    "get_config" : { "pure" : true, "ret" : { "min" : 0, "max" : 3 } },
+ *    "read_buf"   : { "read" : [0],
+ *                     "write" : [ { "arg" : 1, "size_arg" : 2 } ],
+ *                     "ret" : { "min" : -1, "max" : 4096 } },
+ *    "destroy"    : { "free" : [0] }
+ *  }
+ *
+ * "read"   -- arguments that the function only reads (nothing to model)
+ * "write"  -- arguments whose pointed memory the function overwrites,
+ *             either "size" bytes or the number of bytes given by
+ *             the argument "size_arg"
+ * "free"   -- arguments that the function frees
+ * "pure"   -- the function has no side-effects and its return value
+ *             depends only on the values of the arguments (the model
+ *             remembers the arguments and the result of the last call,
+ *             so two consecutive calls with the same arguments return
+ *             the same value)
+ * "ret"    -- the range of the (integer) return value, the bounds are
+ *             unsigned if "min" is not negative and signed otherwise
+ */
+
+namespace {
+
+struct WriteEffect {
+  unsigned arg;
+  uint64_t size{0};
+  int sizeArg{-1};
+};
+
+struct Summary {
+  bool pure{false};
+  std::vector<unsigned> frees;
+  std::vector<WriteEffect> writes;
+  bool hasRetRange{false};
+  int64_t retMin{0};
+  int64_t retMax{0};
+};
+
+class ModelUndefined : public ModulePass {
+  std::map<std::string, Summary> summaries;
+  Type *_size_t_Ty = nullptr; // type of size_t
+
+  bool parseSummaries();
+  bool checkSummary(const Function& F, Summary& S);
+  Type *get_size_t(Module *M);
+  Constant *getNameString(Module *M, const std::string& str);
+  Value *createNondet(IRBuilder<>& IRB, Function *F, const Summary& S);
+  void defineFunction(Function *F, const Summary& S);
+
+public:
+  static char ID;
+
+  ModelUndefined() : ModulePass(ID) {}
+
+  bool runOnModule(Module& M) override;
+};
+
+static RegisterPass<ModelUndefined> MU("model-undefined",
+                                       "Define undefined functions according "
+                                       "to the given summaries of their side-effects");
+char ModelUndefined::ID;
+
+static bool getIndices(const json::Object& obj, StringRef key,
+                       std::vector<unsigned>& out) {
+  auto *arr = obj.getArray(key);
+  if (!arr)
+    return true;
+  for (auto& v : *arr) {
+    auto idx = v.getAsInteger();
+    if (!idx || *idx < 0)
+      return false;
+    out.push_back(static_cast<unsigned>(*idx));
+  }
+  return true;
+}
+
+static bool parseSummary(const json::Object& obj, Summary& S) {
+  if (auto pure = obj.getBoolean("pure"))
+    S.pure = *pure;
+
+  std::vector<unsigned> reads;
+  if (!getIndices(obj, "read", reads) || !getIndices(obj, "free", S.frees))
+    return false;
+
+  if (auto *writes = obj.getArray("write")) {
+    for (auto& w : *writes) {
+      auto *wobj = w.getAsObject();
+      if (!wobj)
+        return false;
+      auto arg = wobj->getInteger("arg");
+      auto size = wobj->getInteger("size");
+      auto sizeArg = wobj->getInteger("size_arg");
+      if (!arg || *arg < 0 || (!size && !sizeArg))
+        return false;
+
+      WriteEffect W;
+      W.arg = static_cast<unsigned>(*arg);
+      if (sizeArg)
+        W.sizeArg = static_cast<int>(*sizeArg);
+      else if (*size >= 0)
+        W.size = static_cast<uint64_t>(*size);
+      else
+        return false;
+      S.writes.push_back(W);
+    }
+  }
+
+  if (auto *ret = obj.getObject("ret")) {
+    auto min = ret->getInteger("min");
+    auto max = ret->getInteger("max");
+    if (!min || !max || *min > *max)
+      return false;
+    S.hasRetRange = true;
+    S.retMin = *min;
+    S.retMax = *max;
+  }
+
+  return true;
+}
+
+bool ModelUndefined::parseSummaries() {
+  auto buf = MemoryBuffer::getFile(summariesFile);
+  if (!buf) {
+    errs() << "ERROR: cannot read summaries file '" << summariesFile << "': "
+           << buf.getError().message() << "\n";
+    return false;
+  }
+
+  auto val = json::parse((*buf)->getBuffer());
+  if (!val) {
+    errs() << "ERROR: invalid summaries file '" << summariesFile << "': "
+           << toString(val.takeError()) << "\n";
+    return false;
+  }
+
+  auto *obj = val->getAsObject();
+  if (!obj) {
+    errs() << "ERROR: summaries file must contain a JSON object\n";
+    return false;
+  }
+
+  for (auto& it : *obj) {
+    std::string name = it.first.str();
+    auto *fobj = it.second.getAsObject();
+    Summary S;
+    if (!fobj || !parseSummary(*fobj, S)) {
+      errs() << "ERROR: invalid summary of function '" << name << "'\n";
+      continue;
+    }
+    summaries.emplace(name, std::move(S));
+  }
+
+  return true;
+}
+
+// check that the summary matches the type of the function
+bool ModelUndefined::checkSummary(const Function& F, Summary& S) {
+  auto isPtrArg = [&F](unsigned idx) {
+    return idx < F.arg_size() && F.getArg(idx)->getType()->isPointerTy();
+  };
+
+  for (unsigned idx : S.frees)
+    if (!isPtrArg(idx))
+      return false;
+
+  for (auto& W : S.writes) {
+    if (!isPtrArg(W.arg))
+      return false;
+    if (W.sizeArg >= 0 &&
+        (static_cast<unsigned>(W.sizeArg) >= F.arg_size() ||
+         !F.getArg(W.sizeArg)->getType()->isIntegerTy()))
+      return false;
+  }
+
+  if (S.hasRetRange) {
+    if (!F.getReturnType()->isIntegerTy())
+      return false;
+    // the bounds must fit into the return type
+    unsigned bits = F.getReturnType()->getIntegerBitWidth();
+    if (bits < 64 &&
+        (S.retMin < 0 ? !isIntN(bits, S.retMin) || !isIntN(bits, S.retMax)
+                      : !isUIntN(bits, S.retMax)))
+      return false;
+  }
+
+  if (S.pure && (!S.frees.empty() || !S.writes.empty())) {
+    errs() << "Function " << F.getName() << " has side-effects, "
+              "ignoring that it is pure\n";
+    S.pure = false;
+  }
+
+  // we can cache only the values that we can compare
+  if (S.pure) {
+    for (auto& A : F.args()) {
+      if (!A.getType()->isIntegerTy() && !A.getType()->isPointerTy())
+        S.pure = false;
+    }
+  }
+
+  return true;
+}
+
+Type *ModelUndefined::get_size_t(Module *M) {
+  if (_size_t_Ty)
+    return _size_t_Ty;
+
+  LLVMContext& Ctx = M->getContext();
+  if (M->getDataLayout().getPointerSizeInBits() > 32)
+    _size_t_Ty = Type::getInt64Ty(Ctx);
+  else
+    _size_t_Ty = Type::getInt32Ty(Ctx);
+
+  return _size_t_Ty;
+}
+
+Constant *ModelUndefined::getNameString(Module *M, const std::string& str) {
+  LLVMContext& Ctx = M->getContext();
+  Constant *name = ConstantDataArray::getString(Ctx, str);
+  GlobalVariable *nameG = new GlobalVariable(*M, name->getType(), true /*constant */,
+                                             GlobalVariable::PrivateLinkage, name);
+  return ConstantExpr::getPointerCast(nameG, Type::getInt8PtrTy(Ctx));
+}
+
+// create a new non-deterministic return value of F (constrained
+// by the summary)
+Value *ModelUndefined::createNondet(IRBuilder<>& IRB, Function *F,
+                                    const Summary& S) {
+  Module *M = F->getParent();
+  LLVMContext& Ctx = M->getContext();
+  Type *Ty = F->getReturnType();
+
+  auto vmsC = M->getOrInsertFunction("__VERIFIER_make_nondet",
+                                     Type::getVoidTy(Ctx),
+                                     Type::getInt8PtrTy(Ctx), // addr
+                                     get_size_t(M),   // nbytes
+                                     Type::getInt8PtrTy(Ctx) // name
+                                     );
+
+  // the entry block may still be empty here
+  BasicBlock& entry = F->getEntryBlock();
+  IRBuilder<> EntryIRB(&entry, entry.getFirstInsertionPt());
+  AllocaInst *AI = EntryIRB.CreateAlloca(Ty);
+  IRB.CreateCall(vmsC, {IRB.CreatePointerCast(AI, Type::getInt8PtrTy(Ctx)),
+                        ConstantInt::get(get_size_t(M),
+                                         M->getDataLayout().getTypeAllocSize(Ty)),
+                        getNameString(M, F->getName().str() + ":undeffun:0")});
+  Value *ret = IRB.CreateLoad(Ty, AI, "undefret");
+
+  if (S.hasRetRange) {
+    auto assumeC = M->getOrInsertFunction("__VERIFIER_assume",
+                                          Type::getVoidTy(Ctx),
+                                          Type::getInt32Ty(Ctx));
+    Value *lo, *hi;
+    if (S.retMin < 0) {
+      lo = IRB.CreateICmpSGE(ret, ConstantInt::get(Ty, S.retMin, true));
+      hi = IRB.CreateICmpSLE(ret, ConstantInt::get(Ty, S.retMax, true));
+    } else {
+      lo = IRB.CreateICmpUGE(ret, ConstantInt::get(Ty, S.retMin));
+      hi = IRB.CreateICmpULE(ret, ConstantInt::get(Ty, S.retMax));
+    }
+    IRB.CreateCall(assumeC, {IRB.CreateZExt(IRB.CreateAnd(lo, hi),
+                                            Type::getInt32Ty(Ctx))});
+  }
+
+  return ret;
+}
+
+void ModelUndefined::defineFunction(Function *F, const Summary& S) {
+  assert(F->isDeclaration());
+
+  Module *M = F->getParent();
+  LLVMContext& Ctx = M->getContext();
+  BasicBlock *block = BasicBlock::Create(Ctx, "entry", F);
+  IRBuilder<> IRB(block);
+
+  for (unsigned idx : S.frees) {
+    auto freeC = M->getOrInsertFunction("free", Type::getVoidTy(Ctx),
+                                        Type::getInt8PtrTy(Ctx));
+    IRB.CreateCall(freeC, {IRB.CreatePointerCast(F->getArg(idx),
+                                                 Type::getInt8PtrTy(Ctx))});
+  }
+
+  // overwrite only the bytes that the function writes to. The pointer
+  // may point into the middle of an object, but KLEE can make symbolic
+  // only whole objects, so we make symbolic a new object of the size
+  // and copy it to the pointer
+  for (auto& W : S.writes) {
+    if (W.sizeArg < 0 && W.size == 0)
+      continue;
+
+    auto vmsC = M->getOrInsertFunction("__VERIFIER_make_nondet",
+                                       Type::getVoidTy(Ctx),
+                                       Type::getInt8PtrTy(Ctx), // addr
+                                       get_size_t(M),   // nbytes
+                                       Type::getInt8PtrTy(Ctx) // name
+                                       );
+    Value *ptr = F->getArg(W.arg);
+    Value *size = W.sizeArg >= 0
+                  ? IRB.CreateZExtOrTrunc(F->getArg(W.sizeArg), get_size_t(M))
+                  : ConstantInt::get(get_size_t(M), W.size);
+
+    Value *cond = IRB.CreateIsNotNull(ptr);
+    if (W.sizeArg >= 0)
+      cond = IRB.CreateAnd(cond, IRB.CreateIsNotNull(size));
+
+    BasicBlock *havoc = BasicBlock::Create(Ctx, "havoc", F);
+    BasicBlock *next = BasicBlock::Create(Ctx, "next", F);
+    IRB.CreateCondBr(cond, havoc, next);
+    IRB.SetInsertPoint(havoc);
+    Value *buf;
+    if (W.sizeArg >= 0) {
+      buf = IRB.CreateAlloca(IRB.getInt8Ty(), size);
+    } else {
+      IRBuilder<> EntryIRB(&F->getEntryBlock(),
+                           F->getEntryBlock().getFirstInsertionPt());
+      buf = EntryIRB.CreateAlloca(ArrayType::get(IRB.getInt8Ty(), W.size));
+    }
+    buf = IRB.CreatePointerCast(buf, Type::getInt8PtrTy(Ctx));
+    IRB.CreateCall(vmsC, {buf, size,
+                          getNameString(M, F->getName().str() + ":undeffun:arg" +
+                                           std::to_string(W.arg))});
+    IRB.CreateMemCpy(IRB.CreatePointerCast(ptr, Type::getInt8PtrTy(Ctx)),
+                     MaybeAlign(), buf, MaybeAlign(), size);
+    IRB.CreateBr(next);
+    IRB.SetInsertPoint(next);
+  }
+
+  Type *Ty = F->getReturnType();
+  if (Ty->isVoidTy()) {
+    IRB.CreateRetVoid();
+  } else if (!S.pure) {
+    IRB.CreateRet(createNondet(IRB, F, S));
+  } else {
+    // pure function: if the function is called with the same arguments
+    // as the last time, return the same value as the last time
+    auto newGlobal = [M, F](Type *Ty, const Twine& name) {
+      return new GlobalVariable(*M, Ty, false /*constant */,
+                                GlobalVariable::PrivateLinkage,
+                                Constant::getNullValue(Ty),
+                                F->getName() + name);
+    };
+
+    GlobalVariable *valid = newGlobal(IRB.getInt1Ty(), ".last.valid");
+    GlobalVariable *retG = newGlobal(Ty, ".last.ret");
+    std::vector<GlobalVariable *> argsG;
+    for (auto& A : F->args())
+      argsG.push_back(newGlobal(A.getType(), ".last.arg" + Twine(A.getArgNo())));
+
+    Value *hit = IRB.CreateLoad(IRB.getInt1Ty(), valid);
+    for (auto& A : F->args()) {
+      Value *old = IRB.CreateLoad(A.getType(), argsG[A.getArgNo()]);
+      hit = IRB.CreateAnd(hit, IRB.CreateICmpEQ(old, &A));
+    }
+
+    BasicBlock *hitB = BasicBlock::Create(Ctx, "same_as_last", F);
+    BasicBlock *missB = BasicBlock::Create(Ctx, "new", F);
+    IRB.CreateCondBr(hit, hitB, missB);
+
+    IRB.SetInsertPoint(hitB);
+    IRB.CreateRet(IRB.CreateLoad(Ty, retG));
+
+    IRB.SetInsertPoint(missB);
+    Value *ret = createNondet(IRB, F, S);
+    for (auto& A : F->args())
+      IRB.CreateStore(&A, argsG[A.getArgNo()]);
+    IRB.CreateStore(ret, retG);
+    IRB.CreateStore(IRB.getTrue(), valid);
+    IRB.CreateRet(ret);
+  }
+
+  F->setLinkage(GlobalValue::LinkageTypes::InternalLinkage);
+}
+
+bool ModelUndefined::runOnModule(Module& M) {
+  if (summariesFile.empty()) {
+    errs() << "ERROR: no summaries file given "
+              "(use -model-undefined-summaries=FILE)\n";
+    return false;
+  }
+
+  if (!parseSummaries())
+    return false;
+
+  bool modified = false;
+  for (auto& it : summaries) {
+    Function *F = M.getFunction(it.first);
+    if (!F || !F->isDeclaration() || F->isIntrinsic())
+      continue;
+
+    Summary& S = it.second;
+    if (!checkSummary(*F, S)) {
+      errs() << "ERROR: summary of function '" << F->getName()
+             << "' does not match its type\n";
+      continue;
+    }
+
+    errs() << "Defining function " << F->getName() << " from its summary\n";
+    defineFunction(F, S);
+    modified = true;
+  }
+
+  return modified;
+}
+
+} // namespace
@@ -0,0 +1,271 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <algorithm>
+#include <system_error>
+
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/IR/Type.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+// for checking irreducibility
+#include "llvm/Analysis/CFG.h"
+#include "llvm/Analysis/LoopInfo.h"
+
+using namespace llvm;
+
+static cl::opt<std::string> output("program-features-output",
+        cl::desc("Write the features of the program in JSON into this file "
+                 "(default: stdout)"),
+        cl::value_desc("file"), cl::init("-"));
+
+// Collect the features of the program that the driver can use to decide
+// how to verify it (which verifier to use, whether to slice, ...).
+// This pass gathers the information of -classify-instructions,
+// -classify-loops, -count-instr and -check-module in a single run.
+// When the structure of the output changes, bump the version.
+namespace {
+
+static const unsigned FEATURES_VERSION = 1;
+
+struct Features {
+  // size
+  uint64_t globals{0}, functions{0}, blocks{0}, instructions{0};
+  // memory
+  bool stack_array{false}, stack_var_array{false};
+  bool malloc{false}, calloc{false}, realloc{false}, free{false};
+  bool big_malloc{false}, var_malloc{false};
+  // operations
+  bool bit_logic{false}, bit_shift{false}, floats{false}, division{false};
+  // loops
+  uint64_t loops{0};
+  unsigned max_loop_depth{0};
+  bool nonterm_loops{false}, irreducible{false};
+  // calls
+  bool indirect_calls{false}, threads{false};
+  uint64_t undefined_calls{0};
+};
+
+class ProgramFeatures : public ModulePass {
+  Features feat;
+
+  void visitCall(CallInst *CI);
+  void visitInstruction(Instruction& I);
+  void visitLoops(Function& F);
+  void print(raw_ostream& os) const;
+
+public:
+  static char ID;
+
+  ProgramFeatures() : ModulePass(ID) {}
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+    AU.addRequired<LoopInfoWrapperPass>();
+  }
+
+  bool runOnModule(Module& M) override;
+};
+
+void ProgramFeatures::visitCall(CallInst *CI) {
+#if LLVM_VERSION_MAJOR >= 8
+  auto *F = dyn_cast<Function>(CI->getCalledOperand()->stripPointerCasts());
+#else
+  auto *F = dyn_cast<Function>(CI->getCalledValue()->stripPointerCasts());
+#endif
+  if (!F) {
+    feat.indirect_calls = true;
+    return;
+  }
+
+  if (F->isIntrinsic())
+    return;
+
+  const auto& name = F->getName();
+  if (name.equals("malloc")) {
+    feat.malloc = true;
+    if (auto C = dyn_cast<ConstantInt>(CI->getArgOperand(0))) {
+      if (C->getZExtValue() > 8)
+        feat.big_malloc = true;
+    } else
+      feat.var_malloc = true;
+  } else if (name.equals("calloc"))
+    feat.calloc = true;
+  else if (name.equals("realloc"))
+    feat.realloc = true;
+  else if (name.equals("free"))
+    feat.free = true;
+  else if (name.equals("alloca"))
+    feat.stack_var_array = true;
+  else if (name.equals("pthread_create"))
+    feat.threads = true;
+
+  if (F->isDeclaration())
+    ++feat.undefined_calls;
+}
+
+void ProgramFeatures::visitInstruction(Instruction& I) {
+  if (I.getType()->isFPOrFPVectorTy())
+    feat.floats = true;
+
+  if (auto *AI = dyn_cast<AllocaInst>(&I)) {
+    if (AI->isArrayAllocation()) {
+      feat.stack_array = true;
+      feat.stack_var_array = true;
+    }
+    if (AI->getAllocatedType()->isArrayTy())
+      feat.stack_array = true;
+  } else if (auto *CI = dyn_cast<CallInst>(&I)) {
+    visitCall(CI);
+  } else {
+    switch (I.getOpcode()) {
+      case Instruction::And:
+      case Instruction::Or:
+      case Instruction::Xor:
+        feat.bit_logic = true;
+        break;
+      case Instruction::Shl:
+      case Instruction::AShr:
+      case Instruction::LShr:
+        feat.bit_shift = true;
+        break;
+      case Instruction::UDiv:
+      case Instruction::SDiv:
+      case Instruction::URem:
+      case Instruction::SRem:
+        feat.division = true;
+        break;
+      case Instruction::FPToSI:
+      case Instruction::FPToUI:
+      case Instruction::FCmp:
+        feat.floats = true;
+        break;
+    }
+  }
+}
+
+void ProgramFeatures::visitLoops(Function& F) {
+  LoopInfo& LI = getAnalysis<LoopInfoWrapperPass>(F).getLoopInfo();
+
+  SmallVector<Loop *, 8> worklist(LI.begin(), LI.end());
+  while (!worklist.empty()) {
+    Loop *L = worklist.pop_back_val();
+    ++feat.loops;
+    feat.max_loop_depth = std::max(feat.max_loop_depth, L->getLoopDepth());
+
+    SmallVector<BasicBlock *, 8> exits;
+    L->getExitBlocks(exits);
+    if (exits.empty())
+      feat.nonterm_loops = true;
+
+    worklist.append(L->begin(), L->end());
+  }
+
+#if LLVM_VERSION_MAJOR > 6
+  if (!feat.irreducible) {
+    ReversePostOrderTraversal<const Function *> RPOT(&F);
+    feat.irreducible = containsIrreducibleCFG<const BasicBlock *>(RPOT, LI);
+  }
+#endif
+}
+
+bool ProgramFeatures::runOnModule(Module& M) {
+  feat.globals = M.global_size();
+
+  for (auto& F : M) {
+    if (F.isDeclaration())
+      continue;
+
+    ++feat.functions;
+    for (auto& B : F) {
+      ++feat.blocks;
+      for (auto& I : B) {
+        ++feat.instructions;
+        visitInstruction(I);
+      }
+    }
+
+    visitLoops(F);
+  }
+
+  std::error_code EC;
+#if LLVM_VERSION_MAJOR >= 9
+  raw_fd_ostream os(output, EC, sys::fs::OF_Text);
+#else
+  raw_fd_ostream os(output, EC, sys::fs::F_Text);
+#endif
+  if (EC) {
+    llvm::errs() << "ERROR: cannot open '" << output << "': "
+                 << EC.message() << "\n";
+    return false;
+  }
+
+  print(os);
+  return false;
+}
+
+void ProgramFeatures::print(raw_ostream& os) const {
+  json::OStream J(os, 2);
+  J.object([&] {
+    J.attribute("version", FEATURES_VERSION);
+
+    J.attributeObject("size", [&] {
+      J.attribute("globals", feat.globals);
+      J.attribute("functions", feat.functions);
+      J.attribute("blocks", feat.blocks);
+      J.attribute("instructions", feat.instructions);
+    });
+
+    J.attributeObject("memory", [&] {
+      J.attribute("stack_array", feat.stack_array);
+      J.attribute("stack_var_array", feat.stack_var_array);
+      J.attribute("malloc", feat.malloc);
+      J.attribute("big_malloc", feat.big_malloc);
+      J.attribute("var_malloc", feat.var_malloc);
+      J.attribute("calloc", feat.calloc);
+      J.attribute("realloc", feat.realloc);
+      J.attribute("free", feat.free);
+    });
+
+    J.attributeObject("operations", [&] {
+      J.attribute("bit_logic", feat.bit_logic);
+      J.attribute("bit_shift", feat.bit_shift);
+      J.attribute("division", feat.division);
+      J.attribute("floats", feat.floats);
+    });
+
+    J.attributeObject("loops", [&] {
+      J.attribute("count", feat.loops);
+      J.attribute("max_depth", feat.max_loop_depth);
+      J.attribute("nested", feat.max_loop_depth > 1);
+      J.attribute("nonterm", feat.nonterm_loops);
+      J.attribute("irreducible", feat.irreducible);
+    });
+
+    J.attributeObject("calls", [&] {
+      J.attribute("indirect", feat.indirect_calls);
+      J.attribute("threads", feat.threads);
+      J.attribute("undefined", feat.undefined_calls);
+    });
+  });
+  os << "\n";
+}
+
+} // namespace
+
+static RegisterPass<ProgramFeatures> PF("program-features",
+                                        "Write the features of the program "
+                                        "in JSON");
+char ProgramFeatures::ID;
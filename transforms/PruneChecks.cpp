@@ -0,0 +1,204 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <cassert>
+#include <vector>
+
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+#include "IntervalAnalysis.h"
+
+using namespace llvm;
+
+static cl::opt<unsigned> maxVisits("prune-checks-max-visits",
+        cl::desc("How many times can the interval analysis visit "
+                 "one instruction on average (default 8)"),
+        cl::init(8));
+
+static cl::opt<unsigned> widenDelay("prune-checks-widen-delay",
+        cl::desc("Number of updates of a PHI node before widening (default 2)"),
+        cl::init(2));
+
+namespace {
+
+class PruneChecks : public ModulePass {
+  unsigned removedChecks{0};
+  unsigned removedErrorPaths{0};
+
+  bool pruneCalls(Function& F, IntervalAnalysis& IA);
+  bool pruneErrorPaths(Function& F, IntervalAnalysis& IA);
+
+public:
+  static char ID;
+
+  PruneChecks() : ModulePass(ID) {}
+
+  bool runOnModule(Module& M) override;
+};
+
+static const Function *getCalledFunction(const CallInst *CI) {
+  return dyn_cast<Function>(CI->getCalledOperand()->stripPointerCasts());
+}
+
+// calls after which the execution of the path is terminated with an error
+static bool isErrorCall(const CallInst *CI) {
+  auto *F = getCalledFunction(CI);
+  if (!F)
+    return false;
+  auto name = F->getName();
+  return name.equals("__VERIFIER_error") || name.equals("__assert_fail") ||
+         name.equals("__INSTR_fail") || name.startswith("__ubsan_handle");
+}
+
+static bool hasErrorCall(const BasicBlock *B) {
+  for (auto& I : *B)
+    if (auto *CI = dyn_cast<CallInst>(&I))
+      if (isErrorCall(CI))
+        return true;
+  return false;
+}
+
+// The check is safe iff the range of its argument is (for assert-like checks)
+// only non-zero or (for check_nontermination) only zero
+static bool isSafeCheck(CallInst *CI, IntervalAnalysis& IA) {
+  auto *F = getCalledFunction(CI);
+  if (!F || CI->arg_size() == 0)
+    return false;
+
+  auto name = F->getName();
+  bool mustBeTrue;
+  if (name.equals("__VERIFIER_assert") ||
+      name.equals("__INSTR_check_assume")) {
+    mustBeTrue = true;
+  } else if (name.equals("__INSTR_check_nontermination")) {
+    mustBeTrue = false;
+  } else {
+    return false;
+  }
+
+  Value *cond = CI->getArgOperand(0);
+  if (!cond->getType()->isIntegerTy())
+    return false;
+
+  ConstantRange CR = IA.getRange(cond, CI->getParent());
+  if (CR.isEmptySet())
+    return false;
+
+  unsigned bw = CR.getBitWidth();
+  if (mustBeTrue)
+    return !CR.contains(APInt::getZero(bw));
+  return CR.isSingleElement() && CR.getSingleElement()->isZero();
+}
+
+bool PruneChecks::pruneCalls(Function& F, IntervalAnalysis& IA) {
+  std::vector<CallInst *> toRemove;
+  for (auto& B : F) {
+    if (!IA.isReachable(&B))
+      continue;
+    for (auto& I : B) {
+      if (auto *CI = dyn_cast<CallInst>(&I)) {
+        if (isSafeCheck(CI, IA))
+          toRemove.push_back(CI);
+      }
+    }
+  }
+
+  for (auto *CI : toRemove) {
+    assert(CI->use_empty());
+    CI->eraseFromParent();
+    ++removedChecks;
+  }
+
+  return !toRemove.empty();
+}
+
+// Turn the conditional branches that can never jump to an error site
+// into unconditional branches
+bool PruneChecks::pruneErrorPaths(Function& F, IntervalAnalysis& IA) {
+  std::vector<std::pair<BranchInst *, unsigned>> toFold;
+  for (auto& B : F) {
+    if (!IA.isReachable(&B))
+      continue;
+    auto *BI = dyn_cast<BranchInst>(B.getTerminator());
+    if (!BI || !BI->isConditional() ||
+        BI->getSuccessor(0) == BI->getSuccessor(1))
+      continue;
+
+    for (unsigned i = 0; i < 2; ++i) {
+      auto *succ = BI->getSuccessor(i);
+      if (!IA.isFeasibleEdge(&B, succ) && hasErrorCall(succ) &&
+          IA.isFeasibleEdge(&B, BI->getSuccessor(1 - i))) {
+        toFold.emplace_back(BI, i);
+        break;
+      }
+    }
+  }
+
+  for (auto& it : toFold) {
+    auto *BI = it.first;
+    auto *dead = BI->getSuccessor(it.second);
+    auto *live = BI->getSuccessor(1 - it.second);
+    dead->removePredecessor(BI->getParent());
+    auto *NewBI = BranchInst::Create(live, BI);
+    NewBI->setDebugLoc(BI->getDebugLoc());
+    Value *cond = BI->getCondition();
+    BI->eraseFromParent();
+    RecursivelyDeleteTriviallyDeadInstructions(cond);
+    ++removedErrorPaths;
+  }
+
+  if (!toFold.empty())
+    removeUnreachableBlocks(F);
+
+  return !toFold.empty();
+}
+
+bool PruneChecks::runOnModule(Module& M) {
+  IntervalAnalysis IA(maxVisits, widenDelay);
+  bool changed = false;
+
+  for (auto& F : M) {
+    if (F.isDeclaration())
+      continue;
+    auto name = F.getName();
+    if (name.startswith("__VERIFIER_") || name.startswith("__INSTR_"))
+      continue;
+
+    IA.analyze(F);
+    // compute the summary now, it stays valid after the pruning
+    // as we remove only checks and infeasible paths
+    if (F.getReturnType()->isIntegerTy())
+      (void) IA.getReturnSummary(&F);
+
+    bool modified = pruneCalls(F, IA);
+    modified |= pruneErrorPaths(F, IA);
+    if (modified) {
+      IA.invalidate(F);
+      changed = true;
+    }
+  }
+
+  if (removedChecks > 0 || removedErrorPaths > 0) {
+    llvm::errs() << "Removed " << removedChecks << " checks and "
+                 << removedErrorPaths << " error paths proven safe\n";
+  }
+
+  return changed;
+}
+
+} // namespace
+
+static RegisterPass<PruneChecks> PRCH("prune-checks",
+                                      "Remove checks and error paths proven safe "
+                                      "by the interval analysis");
+char PruneChecks::ID;
@@ -6,12 +6,15 @@
 #include <vector>
 #include <set>
 
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/IR/CFG.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
 #include "llvm/IR/Type.h"
@@ -26,36 +29,43 @@
 using namespace llvm;
 
 class RemoveInfiniteLoops : public FunctionPass {
-    bool isLoop(BasicBlock *block) {
-     // check if this is a block that unconditionally jumps on itself
-     std::set<BasicBlock *> visited;
-     visited.insert(block);
-     auto *cur = block;
-     do {
-       for (auto& I : *cur) {
-           if (I.mayWriteToMemory())
-               return false;
-           if (isa<CallInst>(&I))
-               return false;
-           if (isa<ReturnInst>(&I))
-               return false;
-       }
-
-       cur = cur->getUniqueSuccessor();
-       if (!cur) {// no loop
-           return false;
-       }
-
-       if (!visited.insert(cur).second) {
-           // hit a cycle
-           return true;
-       }
-     } while (true);
-
-     assert(false && "Should not be reachable");
-     return false;
+    // can the instructions of the block be observed?
+    // (writes to memory, calls that may not return, ...)
+    static bool hasSideEffects(const BasicBlock& block) {
+      for (auto& I : block) {
+        if (isa<DbgInfoIntrinsic>(&I))
+          continue;
+        if (I.mayWriteToMemory())
+          return true;
+        if (isa<CallInst>(&I) || isa<InvokeInst>(&I))
+          return true;
+        if (isa<ReturnInst>(&I))
+          return true;
+      }
+      return false;
     }
 
+    // can the i-th successor of the terminator ever be taken?
+    static bool isFeasibleEdge(const Instruction *T, unsigned i) {
+      if (auto *BI = dyn_cast<BranchInst>(T)) {
+        if (BI->isConditional()) {
+          if (auto *C = dyn_cast<ConstantInt>(BI->getCondition()))
+            return C->isOne() == (i == 0);
+        }
+      } else if (auto *SI = dyn_cast<SwitchInst>(T)) {
+        if (auto *C = dyn_cast<ConstantInt>(SI->getCondition())) {
+#if LLVM_VERSION_MAJOR >= 5
+          return SI->findCaseValue(C)->getSuccessorIndex() == i;
+#else
+          return SI->findCaseValue(C).getSuccessorIndex() == i;
+#endif
+        }
+      }
+      return true;
+    }
+
+    void findDoomedBlocks(Function& F, std::set<BasicBlock *>& doomed);
+
   public:
     static char ID;
 
@@ -65,19 +75,74 @@ class RemoveInfiniteLoops : public FunctionPass {
 };
 
 static RegisterPass<RemoveInfiniteLoops> RIL("remove-infinite-loops",
-                                             "delete patterns like LABEL: goto LABEL"
-                                             "and replace them with exit(0)");
+                                             "delete cycles without side effects (like "
+                                             "LABEL: goto LABEL) and replace them with exit(0)");
 char RemoveInfiniteLoops::ID;
 
 bool CloneMetadata(const llvm::Instruction *i1, llvm::Instruction *i2);
 
+// Find the blocks from which the execution inevitably ends up in a cycle
+// without side effects (i.e., the program hangs without doing anything).
+// The SCCs of the CFG come in post-order (successors first), so when
+// we get to an SCC, we already know whether its successors are doomed.
+void RemoveInfiniteLoops::findDoomedBlocks(Function& F,
+                                           std::set<BasicBlock *>& doomed) {
+  for (auto I = scc_begin(&F); !I.isAtEnd(); ++I) {
+    const std::vector<BasicBlock *>& scc = *I;
+    std::set<BasicBlock *> members(scc.begin(), scc.end());
+
+    bool isDoomed = true;
+    bool hasSuccessor = false;
+    for (BasicBlock *block : scc) {
+      if (hasSideEffects(*block)) {
+        isDoomed = false;
+        break;
+      }
+
+      Instruction *T = block->getTerminator();
+      for (unsigned i = 0, e = T->getNumSuccessors(); i < e; ++i) {
+        if (!isFeasibleEdge(T, i))
+          continue;
+        hasSuccessor = true;
+        BasicBlock *succ = T->getSuccessor(i);
+        if (members.count(succ) == 0 && doomed.count(succ) == 0) {
+          isDoomed = false;
+          break;
+        }
+      }
+
+      if (!isDoomed)
+        break;
+    }
+
+    // a block without successors (return, unreachable) is not doomed
+    if (isDoomed && hasSuccessor)
+      doomed.insert(scc.begin(), scc.end());
+  }
+}
+
 bool RemoveInfiniteLoops::runOnFunction(Function &F) {
   Module *M = F.getParent();
 
+  std::set<BasicBlock *> doomed;
+  findDoomedBlocks(F, doomed);
+
+  // it is enough to cut the doomed blocks where the execution enters them
   std::vector<BasicBlock *> to_process;
   for (BasicBlock& block : F) {
-    if (isLoop(&block))
-        to_process.push_back(&block);
+    if (doomed.count(&block) == 0)
+      continue;
+
+    bool entered = &block == &F.getEntryBlock();
+    for (auto *pred : predecessors(&block)) {
+      if (doomed.count(pred) == 0) {
+        entered = true;
+        break;
+      }
+    }
+
+    if (entered)
+      to_process.push_back(&block);
   }
 
   if (to_process.empty())
@@ -109,6 +174,8 @@ bool RemoveInfiniteLoops::runOnFunction(Function &F) {
 
     // replace the jump with unreachable,
     // since the assume(0) will terminate the computation
+    for (unsigned i = 0, e = T->getNumSuccessors(); i < e; ++i)
+      T->getSuccessor(i)->removePredecessor(block);
     new UnreachableInst(Ctx, T);
     T->eraseFromParent();
   }
@@ -4,7 +4,11 @@
 // License. See LICENSE.TXT for details.
 
 #include <set>
+#include <vector>
 
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/Analysis/CallGraph.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
@@ -34,42 +38,35 @@ public:
   virtual bool runOnModule(Module &M);
 
 private:
-  std::set<Function *> visitedFuns;
-
-  // remove the readonly attribute from F
-  // and also from all functions that call F
-  bool removeROAttrFromCallers(Function& F) {
-    bool changed = false;
-    for (auto use_it = F.use_begin(), use_end = F.use_end();
-         use_it != use_end; ++use_it) {
-#if ((LLVM_VERSION_MAJOR == 3) && (LLVM_VERSION_MINOR < 5))
-      CallInst *CI = dyn_cast<CallInst>(*use_it);
+  // functions that (transitively) call the instrumentation
+  std::set<Function *> effectFuns;
+
+  static bool isInstrumentation(const Function& F) {
+    return F.getName().startswith("__INSTR");
+  }
+
+  // does F call the instrumentation or a function that calls it
+  // from a block that is reachable from the entry of F?
+  bool reachesInstrumentation(Function& F) const {
+    if (F.isDeclaration())
+      return false;
+
+    for (BasicBlock *B : depth_first(&F.getEntryBlock())) {
+      for (Instruction& I : *B) {
+        auto *CI = dyn_cast<CallInst>(&I);
+        if (!CI)
+          continue;
+#if LLVM_VERSION_MAJOR >= 8
+        auto *callee = dyn_cast<Function>(CI->getCalledOperand()->stripPointerCasts());
 #else
-      CallInst *CI = dyn_cast<CallInst>(use_it->getUser());
+        auto *callee = dyn_cast<Function>(CI->getCalledValue()->stripPointerCasts());
 #endif
-      if (CI) {
-        Function *parent = CI->getParent()->getParent();
-        if (parent) {
-            // do not visit a function multiple times
-            // and leave out functions from instrumentation
-            if (parent->getName().startswith("__INSTR"))
-              continue;
-
-            if (!visitedFuns.insert(parent).second)
-              continue;
-
-            // continue recursively
-            changed |= parent->hasFnAttribute(Attribute::ReadOnly);
-            parent->removeFnAttr(Attribute::ReadOnly);
-            //llvm::errs() << "Removed 'readonly' attr from "
-            //             << parent->getName() << "\n";
-
-            changed |= removeROAttrFromCallers(*parent);
-        }
+        if (callee && (isInstrumentation(*callee) || effectFuns.count(callee) > 0))
+          return true;
       }
     }
 
-    return changed;
+    return false;
   }
 };
 
@@ -79,14 +76,76 @@ char RemoveROAttrs::ID;
 
 bool RemoveROAttrs::runOnModule(Module &M) {
   bool changed = false;
+  CallGraph CG(M);
+
+  // The SCCs come in post-order, so callees are summarized before
+  // their callers. Within an SCC we iterate until nothing changes,
+  // as the functions may reach the instrumentation only through
+  // some of the call sites.
+  for (auto I = scc_begin(&CG); !I.isAtEnd(); ++I) {
+    std::vector<Function *> scc;
+    for (CallGraphNode *N : *I) {
+      Function *F = N->getFunction();
+      // leave out functions from instrumentation
+      if (F && !isInstrumentation(*F))
+        scc.push_back(F);
+    }
+
+    bool newEffect;
+    do {
+      newEffect = false;
+      for (Function *F : scc) {
+        if (effectFuns.count(F) > 0)
+          continue;
+
+        if (reachesInstrumentation(*F)) {
+          effectFuns.insert(F);
+          newEffect = true;
+        }
+      }
+    } while (newEffect);
+  }
+
+  unsigned dropped = 0;
+  for (Function *F : effectFuns) {
+    if (F->hasFnAttribute(Attribute::ReadOnly))
+      ++dropped;
+    F->removeFnAttr(Attribute::ReadOnly);
+  }
+
+  // the calls of pure functions carry the attribute too
   for (Function& F : M) {
-    if (F.getName().startswith("__INSTR")) {
-      changed |= removeROAttrFromCallers(F);
+    for (BasicBlock& B : F) {
+      for (Instruction& I : B) {
+        auto *CI = dyn_cast<CallInst>(&I);
+        if (!CI || !CI->hasFnAttr(Attribute::ReadOnly))
+          continue;
+#if LLVM_VERSION_MAJOR >= 8
+        auto *callee = dyn_cast<Function>(CI->getCalledOperand()->stripPointerCasts());
+#else
+        auto *callee = dyn_cast<Function>(CI->getCalledValue()->stripPointerCasts());
+#endif
+        if (!callee || effectFuns.count(callee) == 0)
+          continue;
+#if LLVM_VERSION_MAJOR >= 14
+        CI->removeFnAttr(Attribute::ReadOnly);
+#elif LLVM_VERSION_MAJOR >= 5
+        CI->removeAttribute(AttributeList::FunctionIndex, Attribute::ReadOnly);
+#else
+        CI->removeAttribute(AttributeSet::FunctionIndex, Attribute::ReadOnly);
+#endif
+        ++dropped;
+      }
     }
   }
 
+  if (dropped > 0) {
+    llvm::errs() << "Dropped 'readonly' from " << dropped
+                 << " functions and calls that reach the instrumentation\n";
+    changed = true;
+  }
+
   return changed;
 }
 
 }
-
@@ -0,0 +1,211 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <set>
+#include <vector>
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalAlias.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+static cl::list<std::string> keepFuns("remove-unreachable-functions-keep",
+        cl::desc("Do not remove the given function even if it is unreachable. "
+                 "Can be given multiple times"));
+
+// After linking the runtime and the models of libraries, the module
+// contains a lot of functions that can never be called from main.
+// Remove them, so that the later passes (instrumentation, slicing)
+// do not need to process them. Only the functions that are reachable
+// are materialized, so if the module is loaded lazily, the bodies
+// of the other functions are never read.
+namespace {
+
+class RemoveUnreachableFunctions : public ModulePass {
+  std::set<GlobalValue *> reachable;
+  std::vector<GlobalValue *> queue;
+
+  void enqueue(GlobalValue *G) {
+    if (reachable.insert(G).second)
+      queue.push_back(G);
+  }
+
+  void visitConstant(const Constant *C, std::set<const Constant *>& visited);
+  bool visitFunction(Function& F);
+
+  // functions that may be called by code that we add later
+  // (instrumentation, models of undefined functions)
+  static bool isKept(const Function& F) {
+    const auto& name = F.getName();
+    if (name.startswith("__INSTR") || name.startswith("__VERIFIER") ||
+        name.startswith("__symbiotic"))
+      return true;
+
+    for (auto& keep : keepFuns) {
+      if (name.equals(keep))
+        return true;
+    }
+
+    return false;
+  }
+
+public:
+  static char ID;
+
+  RemoveUnreachableFunctions() : ModulePass(ID) {}
+
+  bool runOnModule(Module& M) override;
+};
+
+// Enqueue all globals referenced by the constant
+void RemoveUnreachableFunctions::visitConstant(const Constant *C,
+                                               std::set<const Constant *>& visited) {
+  if (!visited.insert(C).second)
+    return;
+
+  if (auto *G = dyn_cast<GlobalValue>(C)) {
+    enqueue(const_cast<GlobalValue *>(G));
+    return;
+  }
+
+  for (const Use& U : C->operands()) {
+    if (auto *Op = dyn_cast<Constant>(U.get()))
+      visitConstant(Op, visited);
+  }
+}
+
+bool RemoveUnreachableFunctions::visitFunction(Function& F) {
+#if LLVM_VERSION_MAJOR >= 4
+  if (llvm::Error err = F.materialize()) {
+    std::error_code ec = errorToErrorCode(std::move(err));
+    llvm::errs() << "ERROR: cannot load function '" << F.getName()
+                 << "': " << ec.message() << "\n";
+    return false;
+  }
+#else
+  F.materialize();
+#endif
+
+  std::set<const Constant *> visited;
+  if (F.hasPersonalityFn())
+    visitConstant(F.getPersonalityFn(), visited);
+
+  for (auto& B : F) {
+    for (auto& I : B) {
+      for (const Use& U : I.operands()) {
+        if (auto *C = dyn_cast<Constant>(U.get()))
+          visitConstant(C, visited);
+      }
+    }
+  }
+
+  return true;
+}
+
+bool RemoveUnreachableFunctions::runOnModule(Module& M) {
+  Function *main = M.getFunction("main");
+  if (!main || main->isDeclaration())
+    return false;
+
+  enqueue(main);
+
+  // constructors, destructors and the globals that must be preserved
+  // (they are listed in the llvm.used and similar arrays)
+  for (auto& G : M.globals()) {
+    if (G.getName().startswith("llvm."))
+      enqueue(&G);
+  }
+
+  for (auto& A : M.aliases())
+    enqueue(&A);
+
+  for (auto& F : M) {
+    if (isKept(F))
+      enqueue(&F);
+  }
+
+  while (!queue.empty()) {
+    GlobalValue *G = queue.back();
+    queue.pop_back();
+
+    std::set<const Constant *> visited;
+    if (auto *F = dyn_cast<Function>(G)) {
+      // we cannot tell what the function references
+      if (!visitFunction(*F))
+        return false;
+    } else if (auto *GV = dyn_cast<GlobalVariable>(G)) {
+      if (GV->hasInitializer())
+        visitConstant(GV->getInitializer(), visited);
+    } else if (auto *GA = dyn_cast<GlobalAlias>(G)) {
+      visitConstant(GA->getAliasee(), visited);
+    }
+  }
+
+  std::vector<Function *> deadFuns;
+  for (auto& F : M) {
+    if (!F.isDeclaration() && reachable.count(&F) == 0)
+      deadFuns.push_back(&F);
+  }
+
+  std::vector<GlobalVariable *> deadGlobals;
+  for (auto& G : M.globals()) {
+    if (!G.isDeclaration() && reachable.count(&G) == 0)
+      deadGlobals.push_back(&G);
+  }
+
+  if (deadFuns.empty())
+    return false;
+
+  // first drop the bodies, so that the dead functions
+  // do not reference each other
+  for (auto *F : deadFuns)
+    F->deleteBody();
+
+  // the unreachable globals may reference the dead functions
+  // (e.g., tables of function pointers that are never read)
+  bool erased;
+  do {
+    erased = false;
+    for (auto *&G : deadGlobals) {
+      if (!G)
+        continue;
+      G->removeDeadConstantUsers();
+      if (G->use_empty()) {
+        G->eraseFromParent();
+        G = nullptr;
+        erased = true;
+      }
+    }
+  } while (erased);
+
+  // the functions that are still referenced stay as declarations
+  unsigned removed = 0;
+  for (auto *F : deadFuns) {
+    F->removeDeadConstantUsers();
+    if (F->use_empty()) {
+      F->eraseFromParent();
+      ++removed;
+    }
+  }
+
+  llvm::errs() << "Removed " << deadFuns.size() << " unreachable functions ("
+               << deadFuns.size() - removed << " kept as declarations)\n";
+  return true;
+}
+
+} // namespace
+
+static RegisterPass<RemoveUnreachableFunctions> RUF("remove-unreachable-functions",
+                                                    "Remove functions that are not "
+                                                    "reachable from main");
+char RemoveUnreachableFunctions::ID;
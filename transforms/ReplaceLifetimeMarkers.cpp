@@ -22,17 +22,27 @@
 #else
   #include "llvm/Support/InstIterator.h"
 #endif
+#include "llvm/IR/CFG.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Local.h"
 #include <llvm/IR/DebugInfoMetadata.h>
 
 using namespace llvm;
 
+static cl::opt<bool> keepAll("replace-lifetime-markers-keep-all",
+        cl::desc("Replace all lifetime markers, even those of allocas "
+                 "that cannot be used out of their scope"),
+        cl::init(false));
+
 bool CloneMetadata(const llvm::Instruction *i1, llvm::Instruction *i2);
 
 namespace {
 
 class ReplaceLifetimeMarkers : public FunctionPass {
+    void elideMarkers(AllocaInst *AI, std::set<Instruction *>& elided);
+
   public:
     static char ID;
 
@@ -41,9 +51,175 @@ class ReplaceLifetimeMarkers : public FunctionPass {
     virtual bool runOnFunction(Function &F);
 };
 
+static bool isLifetimeMarker(const Instruction *I) {
+  auto *II = dyn_cast<IntrinsicInst>(I);
+  return II && (II->getIntrinsicID() == Intrinsic::lifetime_start ||
+                II->getIntrinsicID() == Intrinsic::lifetime_end);
+}
+
+// Gather the instructions that access the memory of the alloca
+// and the lifetime markers of the alloca.
+// Return false if the address of the alloca may escape, i.e., it is
+// stored to memory, compared, returned or passed to a function
+// that may capture it.
+static bool collectUses(AllocaInst *AI, std::set<Instruction *>& accesses,
+                        std::set<IntrinsicInst *>& markers) {
+  std::vector<Value *> worklist{AI};
+  std::set<Value *> visited{AI};
+
+  while (!worklist.empty()) {
+    Value *V = worklist.back();
+    worklist.pop_back();
+
+    for (auto *U : V->users()) {
+      auto *I = cast<Instruction>(U);
+      if (isa<BitCastInst>(I) || isa<GetElementPtrInst>(I) ||
+          isa<AddrSpaceCastInst>(I) || isa<PHINode>(I) ||
+          isa<SelectInst>(I)) {
+        if (isa<SelectInst>(I) && I->getOperand(0) == V)
+          return false;
+        if (visited.insert(I).second)
+          worklist.push_back(I);
+      } else if (isa<LoadInst>(I)) {
+        accesses.insert(I);
+      } else if (auto *SI = dyn_cast<StoreInst>(I)) {
+        if (SI->getValueOperand() == V)
+          return false;
+        accesses.insert(I);
+      } else if (isLifetimeMarker(I)) {
+        markers.insert(cast<IntrinsicInst>(I));
+      } else if (isa<DbgInfoIntrinsic>(I)) {
+        continue;
+      } else if (isa<MemIntrinsic>(I)) {
+        accesses.insert(I);
+      } else if (auto *CI = dyn_cast<CallInst>(I)) {
+        // the callee may access the memory during the call,
+        // but it must not keep the pointer
+        for (unsigned i = 0, e = CI->arg_size(); i < e; ++i) {
+          if (CI->getArgOperand(i) == V && !CI->doesNotCapture(i))
+            return false;
+        }
+#if LLVM_VERSION_MAJOR >= 8
+        if (CI->getCalledOperand() == V)
+#else
+        if (CI->getCalledValue() == V)
+#endif
+          return false;
+        accesses.insert(I);
+      } else {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+// Can the execution reach some access starting from the instruction
+// 'from' (or from the entry of the function if 'from' is nullptr)
+// without entering the scope of the object?
+static bool reachesAccess(Function& F, Instruction *from,
+                          const std::set<Instruction *>& accesses,
+                          const std::set<IntrinsicInst *>& markers) {
+  auto isStart = [&markers](Instruction *I) {
+    auto *II = dyn_cast<IntrinsicInst>(I);
+    return II && II->getIntrinsicID() == Intrinsic::lifetime_start &&
+           markers.count(II) > 0;
+  };
+
+  std::vector<BasicBlock *> worklist;
+  std::set<BasicBlock *> visited;
+
+  // the first block is searched only from the given instruction
+  BasicBlock *B = from ? from->getParent() : &F.getEntryBlock();
+  auto it = from ? ++BasicBlock::iterator(from) : B->begin();
+  bool entered = false;
+  for (auto et = B->end(); it != et; ++it) {
+    if (accesses.count(&*it))
+      return true;
+    if (isStart(&*it)) {
+      entered = true;
+      break;
+    }
+  }
+  if (!entered) {
+    for (auto *succ : successors(B))
+      if (visited.insert(succ).second)
+        worklist.push_back(succ);
+  }
+
+  while (!worklist.empty()) {
+    B = worklist.back();
+    worklist.pop_back();
+
+    entered = false;
+    for (auto& I : *B) {
+      if (accesses.count(&I))
+        return true;
+      if (isStart(&I)) {
+        entered = true;
+        break;
+      }
+    }
+    if (entered)
+      continue;
+
+    for (auto *succ : successors(B))
+      if (visited.insert(succ).second)
+        worklist.push_back(succ);
+  }
+
+  return false;
+}
+
+// The scope of an alloca needs to be tracked only if the memory of the
+// alloca can be accessed outside of the scope. If the address never
+// escapes and no access is reachable from the function entry or from
+// the end of the scope without entering the scope again, use-after-scope
+// is impossible and we can drop the markers of the alloca.
+// (This also covers the allocas in loops, whose scope markers would be
+// executed in every iteration.)
+void ReplaceLifetimeMarkers::elideMarkers(AllocaInst *AI,
+                                          std::set<Instruction *>& elided) {
+  std::set<Instruction *> accesses;
+  std::set<IntrinsicInst *> markers;
+  if (!collectUses(AI, accesses, markers) || markers.empty())
+    return;
+
+  Function& F = *AI->getFunction();
+  if (reachesAccess(F, nullptr, accesses, markers))
+    return;
+
+  for (auto *II : markers) {
+    if (II->getIntrinsicID() == Intrinsic::lifetime_end &&
+        reachesAccess(F, II, accesses, markers))
+      return;
+  }
+
+  elided.insert(markers.begin(), markers.end());
+}
+
 bool ReplaceLifetimeMarkers::runOnFunction(Function &F)
 {
   bool modified = false;
+
+  std::set<Instruction *> elided;
+  if (!keepAll) {
+    unsigned allocas = 0;
+    for (auto& I : F.getEntryBlock()) {
+      if (auto *AI = dyn_cast<AllocaInst>(&I)) {
+        auto size = elided.size();
+        elideMarkers(AI, elided);
+        if (elided.size() > size)
+          ++allocas;
+      }
+    }
+
+    if (allocas > 0)
+      llvm::errs() << "Dropped the scope markers of " << allocas
+                   << " allocas in " << F.getName() << "\n";
+  }
+
   Module *M = F.getParent();
   LLVMContext& Ctx = M->getContext();
   auto ver_scope_enterC = M->getOrInsertFunction("__VERIFIER_scope_enter",
@@ -76,6 +252,14 @@ bool ReplaceLifetimeMarkers::runOnFunction(Function &F)
           II->getIntrinsicID() != Intrinsic::lifetime_end)
           continue;
 
+        if (elided.count(II) > 0) {
+          Value *ptr = II->getOperand(1);
+          II->eraseFromParent();
+          RecursivelyDeleteTriviallyDeadInstructions(ptr);
+          modified = true;
+          continue;
+        }
+
         CallInst* CI = nullptr;
         if (II->getIntrinsicID() == Intrinsic::lifetime_start) {
             CI = CallInst::Create(ver_scope_enter, { II->getOperand(1) });
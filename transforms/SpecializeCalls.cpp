@@ -0,0 +1,241 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/IR/Attributes.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+using namespace llvm;
+
+static cl::opt<unsigned> maxClones("specialize-calls-max",
+        cl::desc("The maximal number of specialized functions "
+                 "that are created (default: 16)"),
+        cl::init(16));
+
+static cl::opt<unsigned> maxSize("specialize-calls-max-size",
+        cl::desc("Specialize only functions with at most this many "
+                 "instructions (default: 500)"),
+        cl::init(500));
+
+// the functions that -ainline must not inline (AInliner.cpp),
+// we do not clone them either
+extern cl::list<std::string> noinline;
+
+bool CloneMetadata(const llvm::Instruction *i1, llvm::Instruction *i2);
+
+// Clone functions for the call sites that pass constants to parameters
+// that the function branches on, e.g.,
+//
+//   process(buf, MODE_READ)   -->   process.spec(buf)
+//
+// where process.spec is process with the parameter replaced by MODE_READ
+// and folded, so the branches for other modes are removed before
+// slicing. The call sites with the same constants share the clone.
+namespace {
+
+class SpecializeCalls : public ModulePass {
+  // the constants for the parameters (in the order of parameters)
+  using Signature = std::vector<std::pair<unsigned, ConstantInt *>>;
+  // specialization cache
+  std::map<std::pair<Function *, Signature>, Function *> _clones;
+  unsigned _clones_num = 0;
+
+  static bool isSpecializable(const Function& F);
+  static bool isBranchedOn(const Argument *A);
+  static void fold(Function *F);
+  Function *getClone(Function *F, const Signature& sig);
+  bool specialize(CallInst *CI);
+
+public:
+  static char ID;
+
+  SpecializeCalls() : ModulePass(ID) {}
+
+  bool runOnModule(Module& M) override;
+};
+
+bool SpecializeCalls::isSpecializable(const Function& F) {
+  if (F.isDeclaration() || F.isVarArg() || F.arg_empty())
+    return false;
+
+  const auto& name = F.getName();
+  if (name.equals("main") || name.startswith("__VERIFIER_") ||
+      name.startswith("__INSTR_"))
+    return false;
+
+  for (const auto& ignore : noinline) {
+    if (name.equals(ignore))
+      return false;
+  }
+
+  return F.getInstructionCount() <= maxSize;
+}
+
+// Does the function branch (or select) on the value of the argument?
+// Only such arguments are worth specializing.
+bool SpecializeCalls::isBranchedOn(const Argument *A) {
+  for (auto *U : A->users()) {
+    if (isa<SwitchInst>(U))
+      return true;
+    if (auto *Cmp = dyn_cast<ICmpInst>(U)) {
+      for (auto *CU : Cmp->users()) {
+        if (isa<BranchInst>(CU) || isa<SelectInst>(CU))
+          return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+// Fold the constants that were substituted for the arguments
+// and remove the branches that became unreachable
+void SpecializeCalls::fold(Function *F) {
+  const DataLayout& DL = F->getParent()->getDataLayout();
+  bool changed;
+  do {
+    changed = false;
+    for (auto& B : *F) {
+      for (auto it = B.begin(), E = B.end(); it != E;) {
+        Instruction *I = &*it++;
+        if (Constant *C = ConstantFoldInstruction(I, DL)) {
+          I->replaceAllUsesWith(C);
+          I->eraseFromParent();
+          changed = true;
+        }
+      }
+      changed |= ConstantFoldTerminator(&B, true);
+    }
+    changed |= removeUnreachableBlocks(*F);
+  } while (changed);
+}
+
+Function *SpecializeCalls::getClone(Function *F, const Signature& sig) {
+  auto key = std::make_pair(F, sig);
+  auto it = _clones.find(key);
+  if (it != _clones.end())
+    return it->second;
+
+  if (_clones_num >= maxClones)
+    return nullptr;
+
+  // the arguments mapped to constants are removed from the clone
+  ValueToValueMapTy VMap;
+  for (auto& arg : sig)
+    VMap[&*std::next(F->arg_begin(), arg.first)] = arg.second;
+
+  Function *clone = CloneFunction(F, VMap);
+  clone->setName(F->getName() + ".spec");
+  clone->setLinkage(GlobalValue::InternalLinkage);
+  fold(clone);
+
+  ++_clones_num;
+  _clones[key] = clone;
+  return clone;
+}
+
+bool SpecializeCalls::specialize(CallInst *CI) {
+  Function *F = CI->getCalledFunction();
+  if (!F || CI->arg_size() != F->arg_size() || !isSpecializable(*F))
+    return false;
+
+  Signature sig;
+  for (unsigned i = 0, e = CI->arg_size(); i < e; ++i) {
+    auto *C = dyn_cast<ConstantInt>(CI->getArgOperand(i));
+    if (C && isBranchedOn(&*std::next(F->arg_begin(), i)))
+      sig.emplace_back(i, C);
+  }
+
+  if (sig.empty())
+    return false;
+
+  Function *clone = getClone(F, sig);
+  if (!clone)
+    return false;
+
+  // the remaining arguments with their attributes
+  const AttributeList& attrs = CI->getAttributes();
+  std::vector<Value *> args;
+  std::vector<AttributeSet> argAttrs;
+  auto sigIt = sig.begin();
+  for (unsigned i = 0, e = CI->arg_size(); i < e; ++i) {
+    if (sigIt != sig.end() && sigIt->first == i) {
+      ++sigIt;
+      continue;
+    }
+    args.push_back(CI->getArgOperand(i));
+#if LLVM_VERSION_MAJOR >= 14
+    argAttrs.push_back(attrs.getParamAttrs(i));
+#else
+    argAttrs.push_back(attrs.getParamAttributes(i));
+#endif
+  }
+
+  SmallVector<OperandBundleDef, 2> bundles;
+  CI->getOperandBundlesAsDefs(bundles);
+
+  auto *NewCI = CallInst::Create(clone, args, bundles, "", CI);
+#if LLVM_VERSION_MAJOR >= 14
+  NewCI->setAttributes(AttributeList::get(CI->getContext(), attrs.getFnAttrs(),
+                                          attrs.getRetAttrs(), argAttrs));
+#else
+  NewCI->setAttributes(AttributeList::get(CI->getContext(),
+                                          attrs.getFnAttributes(),
+                                          attrs.getRetAttributes(), argAttrs));
+#endif
+  NewCI->setCallingConv(CI->getCallingConv());
+  NewCI->setTailCall(CI->isTailCall());
+  CloneMetadata(CI, NewCI);
+  NewCI->takeName(CI);
+  CI->replaceAllUsesWith(NewCI);
+  CI->eraseFromParent();
+  return true;
+}
+
+bool SpecializeCalls::runOnModule(Module& M) {
+  // collect the calls first, we add functions to the module
+  std::vector<CallInst *> calls;
+  for (auto& F : M) {
+    for (auto& B : F) {
+      for (auto& I : B) {
+        auto *CI = dyn_cast<CallInst>(&I);
+        if (CI && CI->getCalledFunction() &&
+            !CI->getCalledFunction()->isDeclaration())
+          calls.push_back(CI);
+      }
+    }
+  }
+
+  unsigned specialized = 0;
+  for (auto *CI : calls) {
+    if (specialize(CI))
+      ++specialized;
+  }
+
+  if (specialized > 0)
+    llvm::errs() << "Specialized " << specialized << " calls using "
+                 << _clones_num << " clones\n";
+  return specialized > 0;
+}
+
+} // namespace
+
+static RegisterPass<SpecializeCalls> SC("specialize-calls",
+                                        "Clone functions for call sites "
+                                        "with constant arguments");
+char SpecializeCalls::ID;
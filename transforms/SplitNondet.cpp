@@ -0,0 +1,87 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/CommandLine.h"
+
+#include "SplitNondet.h"
+
+using namespace llvm;
+
+static cl::opt<uint64_t> splitMaxSize("split-nondet-max-size",
+        cl::desc("Make structs and arrays of at most this many bytes "
+                 "nondeterministic field by field, so that every scalar "
+                 "field is a separate symbolic object (default: 0 = never)"),
+        cl::init(0));
+
+static void collectFields(const DataLayout& DL, Type *Ty, uint64_t offset,
+                          const std::string& suffix,
+                          std::vector<NondetField>& fields) {
+  if (auto *STy = dyn_cast<StructType>(Ty)) {
+    const StructLayout *SL = DL.getStructLayout(STy);
+    for (unsigned i = 0, e = STy->getNumElements(); i < e; ++i)
+      collectFields(DL, STy->getElementType(i),
+                    offset + SL->getElementOffset(i),
+                    suffix + "." + std::to_string(i), fields);
+  } else if (auto *ATy = dyn_cast<ArrayType>(Ty)) {
+    uint64_t elemSize = DL.getTypeAllocSize(ATy->getElementType());
+    for (uint64_t i = 0, e = ATy->getNumElements(); i < e; ++i)
+      collectFields(DL, ATy->getElementType(), offset + i * elemSize,
+                    suffix + "[" + std::to_string(i) + "]", fields);
+  } else {
+    fields.push_back(NondetField{offset, DL.getTypeStoreSize(Ty), suffix});
+  }
+}
+
+bool getNondetFields(const DataLayout& DL, Type *Ty,
+                     std::vector<NondetField>& fields) {
+  if (!Ty->isAggregateType() || !Ty->isSized())
+    return false;
+
+  uint64_t size = DL.getTypeAllocSize(Ty);
+  if (size == 0 || size > splitMaxSize)
+    return false;
+
+  fields.clear();
+  collectFields(DL, Ty, 0, "", fields);
+  if (fields.size() < 2)
+    return false;
+
+  // padding (and the bytes of a field that are beyond its store size)
+  // belong to the preceding field, so that no byte is left uninitialized
+  for (size_t i = 0; i < fields.size(); ++i) {
+    uint64_t end = i + 1 < fields.size() ? fields[i + 1].offset : size;
+    fields[i].size = end - fields[i].offset;
+  }
+
+  return true;
+}
+
+AllocaInst *createFieldObject(const DataLayout& DL, uint64_t size,
+                              Instruction *pos) {
+  Type *Ty = ArrayType::get(Type::getInt8Ty(pos->getContext()), size);
+#if LLVM_VERSION_MAJOR >= 5
+  return new AllocaInst(Ty, DL.getAllocaAddrSpace(), nullptr, "nondet.field",
+                        pos);
+#else
+  (void) DL;
+  return new AllocaInst(Ty, nullptr, "nondet.field", pos);
+#endif
+}
+
+Instruction *createFieldCopy(Value *dst, Value *src, uint64_t size,
+                             Instruction *pos) {
+  IRBuilder<> IRB(pos);
+#if LLVM_VERSION_MAJOR >= 10
+  return IRB.CreateMemCpy(dst, MaybeAlign(1), src, MaybeAlign(1), size);
+#elif LLVM_VERSION_MAJOR >= 7
+  return IRB.CreateMemCpy(dst, 1, src, 1, size);
+#else
+  return IRB.CreateMemCpy(dst, src, size, 1);
+#endif
+}
@@ -0,0 +1,55 @@
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef SBT_SPLIT_NONDET_H_
+#define SBT_SPLIT_NONDET_H_
+
+#include <string>
+#include <vector>
+
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Type.h"
+
+/** A part of an aggregate that is made nondeterministic
+ * as a separate symbolic object.
+ *
+ * The field covers also the padding that follows it, so that
+ * the fields together cover all the bytes of the aggregate.
+ * 'suffix' is appended to the name of the aggregate to get the name
+ * of the field, e.g., ".1[2]" for the third element of an array
+ * that is the second member of a struct.
+ */
+struct NondetField {
+  uint64_t offset;
+  uint64_t size;
+  std::string suffix;
+};
+
+/** Get the scalar fields of the aggregate type @Ty if the memory
+ * of this type should be made nondeterministic field by field
+ * (see -split-nondet-max-size).
+ *
+ * @return false if the memory should be made nondeterministic at once
+ */
+bool getNondetFields(const llvm::DataLayout& DL, llvm::Type *Ty,
+                     std::vector<NondetField>& fields);
+
+/** Create before @pos a new object of @size bytes that is made
+ * nondeterministic instead of a field. KLEE can make symbolic only
+ * whole objects, so the object is then copied to the field
+ * (see createFieldCopy).
+ */
+llvm::AllocaInst *createFieldObject(const llvm::DataLayout& DL, uint64_t size,
+                                    llvm::Instruction *pos);
+
+/** Copy @size bytes of the object @src to the field @dst before @pos.
+ *
+ * @return the copying instruction
+ */
+llvm::Instruction *createFieldCopy(llvm::Value *dst, llvm::Value *src,
+                                   uint64_t size, llvm::Instruction *pos);
+
+#endif // SBT_SPLIT_NONDET_H_
@@ -13,6 +13,8 @@
 
 #include "llvm/Support/CommandLine.h"
 
+#include "LoopMetadata.h"
+
 #include <map>
 
 using namespace llvm;
@@ -179,7 +181,15 @@ bool LoopUnroll::runOnLoop(Loop *L, LPPassManager& /*LPM*/) {
   if (LastBlocks[0] != L->getHeader())
       abort();
 
-  for (unsigned n = 1; n < UnrollCount; ++n)
+  // if we know that the header is executed at most N times
+  // (from -classify-loops-annotate), N copies of the body are enough
+  unsigned count = UnrollCount;
+  SbtLoopInfo info;
+  if (getSbtLoopInfo(L, info) && info.tripBound > 0 &&
+      info.tripBound < count)
+    count = info.tripBound;
+
+  for (unsigned n = 1; n < count; ++n)
       LastBlocks = cloneLoopBody(F, LastBlocks);
 
   // replace the next iterations with assume(false) if desired